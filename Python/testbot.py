@@ -83,8 +83,19 @@ class MyBot(BotAI):
                  time_limit: int = 600,
                  action_selection: ActionSelection = ActionSelection.BestAction,
                  future_action_queue_length: int = 1,
-                 minimum_search_rollouts: int = 5000) -> None:
-        self.mcts = Mcts(State(), mcts_seed, mcts_rollout_end_time, mcts_exploration, mcts_value_heuristics, mcts_rollout_heuristics, end_probability_function=1, army_value_function=ArmyValueFunction.min_power)
+                 minimum_search_rollouts: int = 5000,
+                 mcts_trees: int = 1,
+                 mcts_open_loop: bool = False,
+                 mcts_memory_budget: int = 0) -> None:
+        # More than one tree searches them root parallel, each on a thread of its own
+        if mcts_trees > 1:
+            self.mcts = MctsEnsemble(State(), mcts_seed, mcts_rollout_end_time, mcts_exploration, mcts_value_heuristics, mcts_rollout_heuristics, end_probability_function=1, army_value_function=ArmyValueFunction.min_power, trees=mcts_trees)
+        else:
+            self.mcts = Mcts(State(), mcts_seed, mcts_rollout_end_time, mcts_exploration, mcts_value_heuristics, mcts_rollout_heuristics, end_probability_function=1, army_value_function=ArmyValueFunction.min_power)
+        # Open loop trees keep no states below the root, and sample the enemy anew on every search
+        self.mcts.set_open_loop(mcts_open_loop)
+        # Once the trees reach the budget, in bytes, they stop growing and prune their least visited subtrees
+        self.mcts.set_memory_budget(mcts_memory_budget)
         self.mcts_settings = [
             mcts_seed,
             mcts_rollout_end_time,
@@ -98,6 +109,8 @@ class MyBot(BotAI):
         self.fixed_search_rollouts = minimum_search_rollouts
         self.next_action: Action = Action.none
         self.future_action_queue: queue.Queue = queue.Queue(maxsize=future_action_queue_length)
+        # The sequence number of the latest root posted to the search
+        self.posted_root = 0
 
     async def on_start(self):
         self.information_manager = InformationManager(self)
@@ -365,28 +378,44 @@ class MyBot(BotAI):
 
     async def on_end(self, game_result: Result):
         self.mcts.stop_search()
+        if isinstance(self.mcts, Mcts):
+            for latency in self.mcts.get_request_latencies():
+                print(f"{latency.request}: {latency.count} calls, p50 {latency.p50:.1f} us, p99 {latency.p99:.1f} us")
+        reuse = self.mcts.get_tree_reuse()
+        print(f"tree reuse: {reuse.hits}/{reuse.attempts} roots ({reuse.hit_rate:.0%}), {reuse.reused_visits} visits kept")
+        memory = self.mcts.get_tree_memory()
+        print(f"tree memory: {memory.nodes} nodes, {memory.bytes / 2**20:.1f} MiB, {memory.reserved_bytes / 2**20:.1f} MiB reserved, {memory.pruned_nodes} nodes pruned")
         end_state = translate_state(self)
         # save_result(self, end_state, self.time)
         self.future_action_queue.queue.clear()
 
-    def get_best_action(self) -> None:
+    def get_best_action(self, minimum_rollouts: int = 0) -> None:
+        # The one wait on the search: the rollouts and the best action are only those of the latest root once the
+        # search has adopted it
+        self.mcts.wait_for_root(self.posted_root)
+        while self.mcts.get_number_of_rollouts() < minimum_rollouts:
+            sleep(0.01)
         print(self.mcts.get_number_of_rollouts())
         action = self.mcts.get_best_action()
         self.set_next_action(action)
         state = translate_state(self)
-        self.mcts.update_root_state(state)
-        self.mcts.perform_action(action)
+        # The search adopts the new root between its searches, so the game loop does not wait for it
+        self.posted_root = self.mcts.post_root_state(state, [action])
 
     def get_best_action_min(self) -> None:
-        while self.mcts.get_number_of_rollouts() < self.fixed_search_rollouts:
-            sleep(0.01)
-        self.get_best_action()
+        self.get_best_action(self.fixed_search_rollouts)
 
-    def get_multi_best_action(self) -> None:
+    def get_multi_best_action(self, minimum_rollouts: int = 0) -> None:
         if not self.future_action_queue.empty():
             self.set_next_action(self.future_action_queue.get())
             return
+        # The one wait on the search, as in get_best_action
+        self.mcts.wait_for_root(self.posted_root)
+        while self.mcts.get_number_of_rollouts() < minimum_rollouts:
+            sleep(0.01)
         print(self.mcts.get_number_of_rollouts())
+        # The queued actions are picked by walking the searched tree, the posted root then takes them all from the
+        # observed state
         action = self.mcts.get_best_action()
         self.mcts.perform_action(action)
         for i in range(self.future_action_queue.maxsize):
@@ -394,19 +423,11 @@ class MyBot(BotAI):
             self.mcts.perform_action(a)
             self.future_action_queue.put(a)
         state = translate_state(self)
-        self.mcts.update_root_state(state)
-        self.mcts.perform_action(action)
-        for a in list(self.future_action_queue.queue):
-            self.mcts.perform_action(a)
+        self.posted_root = self.mcts.post_root_state(state, [action, *self.future_action_queue.queue])
         self.set_next_action(action)
 
     def get_multi_best_action_min(self) -> None:
-        if not self.future_action_queue.empty():
-            self.set_next_action(self.future_action_queue.get())
-            return
-        while self.mcts.get_number_of_rollouts() < self.fixed_search_rollouts:
-            sleep(0.01)
-        self.get_multi_best_action()
+        self.get_multi_best_action(self.fixed_search_rollouts)
 
     def set_next_action(self, action: Action = Action.none):
         self.next_action = action
@@ -2,11 +2,15 @@
 // Created by marco on 25/11/2024.
 //
 
+#include <algorithm>
 #include <iostream>
 #include <chrono>
 #include <fstream>
+#include <thread>
+#include <sys/resource.h>
 
 #include "Mcts.h"
+#include "MctsEnsemble.h"
 // #include "Sc2State.h"
 using namespace Sc2::Mcts;
 using namespace std::chrono;
@@ -106,12 +110,12 @@ struct BenchmarkResult {
 	}
 };
 
-void printRootNode(const std::shared_ptr<Node> &rootNode) {
+void printRootNode(const Node *rootNode) {
 	std::cout << "-------ROOT-------\n"
 			<< *rootNode << std::endl;
 
 	//print children
-	for (const auto &[action, node]: rootNode->children) {
+	for (const auto node: rootNode->getChildren()) {
 		std::cout << "---CHILD---\n"
 				<< *node << std::endl;
 	}
@@ -616,7 +620,213 @@ calculateAverageBenchmarks(const std::vector<std::vector<BenchmarkResult> > &ben
 	return averageBenchmarkResult;
 }
 
-int main() {
+std::shared_ptr<Sc2::State> midGameState(const unsigned int seed) {
+	auto state = std::make_shared<Sc2::State>(480, 1, Sc2::ArmyValueFunction::MinPower, seed);
+	state->buildWorker();
+	state->buildHouse();
+	state->buildWorker();
+	state->buildVespeneCollector();
+	state->buildBase();
+	state->buildBarracks();
+	state->buildWorker();
+	state->buildMarine();
+	state->buildWorker();
+	return state;
+}
+
+void copyBenchmark(const int numberOfCopies) {
+	const auto state = midGameState(0);
+	int checksum = 0;
+
+	const auto start = steady_clock::now();
+	for (int i = 0; i < numberOfCopies; i++) {
+		const auto copy = Sc2::State::DeepCopy(*state);
+		checksum += copy->getMinerals();
+	}
+	const duration<double> elapsed = steady_clock::now() - start;
+
+	std::cout << "State::DeepCopy: " << static_cast<long>(numberOfCopies / elapsed.count()) << " copies/sec"
+			<< " (checksum " << checksum << ")" << std::endl;
+}
+
+void rolloutBenchmark(const int numberOfRollouts, const unsigned int seed) {
+	const auto state = midGameState(seed);
+	auto mcts = Mcts(state, seed, 480, sqrt(2), ValueHeuristic::UCT, RolloutHeuristic::WeightedChoice, 1,
+	                 Sc2::ArmyValueFunction::MinPower);
+	const auto rootNode = mcts.getRootNode();
+	double checksum = 0;
+
+	const auto start = steady_clock::now();
+	for (int i = 0; i < numberOfRollouts; i++) {
+		checksum += mcts.rollout(rootNode);
+	}
+	const duration<double> elapsed = steady_clock::now() - start;
+
+	std::cout << "Mcts::rollout: " << static_cast<long>(numberOfRollouts / elapsed.count()) << " rollouts/sec"
+			<< " (mean outcome " << checksum / numberOfRollouts << ")" << std::endl;
+}
+
+int countNodes(const Node *node) {
+	int count = 1;
+	for (const auto child: node->getChildren()) {
+		count += countNodes(child);
+	}
+	return count;
+}
+
+// The peak resident set size of the process in kilobytes
+long peakMemory() {
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+void nodeBenchmark(const int numberOfRollouts, const unsigned int seed, const bool openLoop = false) {
+	const auto state = midGameState(seed);
+	auto mcts = Mcts(state, seed, 480, sqrt(2), ValueHeuristic::UCT, RolloutHeuristic::WeightedChoice, 1,
+	                 Sc2::ArmyValueFunction::MinPower);
+	mcts.setOpenLoop(openLoop);
+
+	const auto start = steady_clock::now();
+	mcts.searchRollout(numberOfRollouts);
+	const duration<double> elapsed = steady_clock::now() - start;
+	const auto nodes = countNodes(mcts.getRootNode());
+
+	std::cout << "Mcts::searchRollout" << (openLoop ? " open loop" : "") << ": "
+			<< static_cast<long>(nodes / elapsed.count()) << " nodes/sec, "
+			<< static_cast<long>(numberOfRollouts / elapsed.count()) << " rollouts/sec"
+			<< " (" << nodes << " nodes, " << mcts.getTranspositionCount() << " distinct states, peak RSS "
+			<< peakMemory() / 1024 << " MB)" << std::endl;
+}
+
+// Searches with an increasing number of threads, sharing one tree and with a tree per thread
+void scalingBenchmark(const int numberOfRollouts, const unsigned int seed) {
+	const auto maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	double sharedSingleThreaded = 0;
+	double ensembleSingleThreaded = 0;
+
+	for (unsigned int threads = 1; threads <= maxThreads; threads++) {
+		const auto state = midGameState(seed);
+		auto mcts = Mcts(state, seed, 480, sqrt(2), ValueHeuristic::UCT, RolloutHeuristic::WeightedChoice, 1,
+		                 Sc2::ArmyValueFunction::MinPower);
+
+		auto start = steady_clock::now();
+		mcts.startSearchRolloutThread(numberOfRollouts, static_cast<int>(threads));
+		// The threads stop by themselves once the tree has seen the rollouts
+		mcts.stopSearchThread();
+		duration<double> elapsed = steady_clock::now() - start;
+		const auto shared = mcts.getNumberOfRollouts() / elapsed.count();
+		if (threads == 1) {
+			sharedSingleThreaded = shared;
+		}
+
+		auto ensemble = MctsEnsemble(state, seed, 480, sqrt(2), ValueHeuristic::UCT,
+		                             RolloutHeuristic::WeightedChoice, 1, Sc2::ArmyValueFunction::MinPower,
+		                             static_cast<int>(threads));
+		start = steady_clock::now();
+		ensemble.startSearchRolloutThread(numberOfRollouts);
+		ensemble.stopSearchThread();
+		elapsed = steady_clock::now() - start;
+		const auto rootParallel = ensemble.getNumberOfRollouts() / elapsed.count();
+		if (threads == 1) {
+			ensembleSingleThreaded = rootParallel;
+		}
+
+		std::cout << threads << " threads: shared tree " << static_cast<long>(shared) << " rollouts/sec"
+				<< " (speedup " << shared / sharedSingleThreaded << "), ensemble "
+				<< static_cast<long>(rootParallel) << " rollouts/sec"
+				<< " (speedup " << rootParallel / ensembleSingleThreaded << ")" << std::endl;
+	}
+}
+
+// Runs batches of rollouts from each selected node, with the threads beyond the searching one as rollout workers
+void leafBenchmark(const int numberOfRollouts, const unsigned int seed) {
+	const auto workers = static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) - 1;
+
+	for (const auto rolloutsPerLeaf: {1, 2, 4, 8}) {
+		const auto state = midGameState(seed);
+		auto mcts = Mcts(state, seed, 480, sqrt(2), ValueHeuristic::UCT, RolloutHeuristic::WeightedChoice, 1,
+		                 Sc2::ArmyValueFunction::MinPower);
+		mcts.setLeafParallelism(rolloutsPerLeaf, workers);
+
+		const auto start = steady_clock::now();
+		mcts.searchRollout(numberOfRollouts);
+		const duration<double> elapsed = steady_clock::now() - start;
+
+		std::cout << rolloutsPerLeaf << " rollouts per leaf, " << workers << " workers: "
+				<< static_cast<long>(mcts.getNumberOfRollouts() / elapsed.count()) << " rollouts/sec, "
+				<< static_cast<long>(countNodes(mcts.getRootNode()) / elapsed.count()) << " nodes/sec" << std::endl;
+	}
+}
+
+// Makes the calls the bot makes on every step while the search runs, and reports how long they took
+void latencyBenchmark(const int steps, const unsigned int seed) {
+	const auto state = midGameState(seed);
+	auto mcts = Mcts(state, seed, 480, sqrt(2), ValueHeuristic::UCT, RolloutHeuristic::WeightedChoice, 1,
+	                 Sc2::ArmyValueFunction::MinPower);
+	mcts.startSearchThread(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+	// Reading the results does not hold the tree, so the reads are timed here rather than by the search
+	LatencyRecorder rolloutReads;
+	LatencyRecorder bestActionReads;
+	LatencyRecorder rootPosts;
+
+	for (int step = 0; step < steps; step++) {
+		std::this_thread::sleep_for(milliseconds(1));
+		auto start = steady_clock::now();
+		(void) mcts.getNumberOfRollouts();
+		rolloutReads.record(duration<double, std::micro>(steady_clock::now() - start).count());
+
+		start = steady_clock::now();
+		const auto action = mcts.getBestAction();
+		bestActionReads.record(duration<double, std::micro>(steady_clock::now() - start).count());
+		if (step % 100 == 99 && action != Action::none) {
+			mcts.performAction(action);
+		}
+		if (step % 100 == 49) {
+			start = steady_clock::now();
+			mcts.postRootState(state);
+			rootPosts.record(duration<double, std::micro>(steady_clock::now() - start).count());
+		}
+	}
+	mcts.stopSearchThread();
+
+	std::vector<RequestLatency> latencies = {
+		{"get_number_of_rollouts", rolloutReads.count(), rolloutReads.percentile(0.5), rolloutReads.percentile(0.99)},
+		{"get_best_action", bestActionReads.count(), bestActionReads.percentile(0.5), bestActionReads.percentile(0.99)},
+		{"post_root_state", rootPosts.count(), rootPosts.percentile(0.5), rootPosts.percentile(0.99)}
+	};
+	for (const auto &latency: mcts.getRequestLatencies()) {
+		latencies.push_back(latency);
+	}
+	for (const auto &[request, count, p50, p99]: latencies) {
+		std::cout << request << ": " << count << " calls, p50 " << p50 << " us, p99 " << p99 << " us" << std::endl;
+	}
+}
+
+int main(const int argc, char *argv[]) {
+	if (argc > 1) {
+		const std::string mode = argv[1];
+		if (mode == "copies") {
+			copyBenchmark(1000000);
+		} else if (mode == "rollouts") {
+			rolloutBenchmark(20000, 3942438310);
+		} else if (mode == "nodes") {
+			nodeBenchmark(100000, 3942438310);
+		} else if (mode == "open-loop") {
+			nodeBenchmark(100000, 3942438310, true);
+		} else if (mode == "scaling") {
+			scalingBenchmark(100000, 3942438310);
+		} else if (mode == "leaves") {
+			leafBenchmark(40000, 3942438310);
+		} else if (mode == "latency") {
+			latencyBenchmark(2000, 3942438310);
+		} else {
+			std::cerr << "Unknown benchmark: " << mode << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
 	unsigned int seed = 3942438310;
 	constexpr int numberOfRuns = 10;
 	constexpr int runTime = 480;
@@ -4,6 +4,7 @@
 
 #ifndef ACTIONENUM_H
 #define ACTIONENUM_H
+#include <cstddef>
 #include <string>
 
 enum class Action {
@@ -20,6 +21,8 @@ enum class Action {
     buildViking,
 };
 
+constexpr std::size_t ACTION_COUNT = 11;
+
 inline std::string actionToString(Action action) {
     std::string actionString;
     switch (action) {
@@ -4,6 +4,9 @@
 
 #include <chrono>
 #include <complex>
+#include <exception>
+#include <latch>
+#include <limits>
 #include <random>
 #include <ranges>
 
@@ -14,22 +17,8 @@ using namespace Sc2::Mcts;
 using namespace std::chrono;
 
 
-std::shared_ptr<Node> Mcts::randomChoice(const std::map<Action, std::shared_ptr<Node> > &nodes) {
-	if (nodes.empty()) {
-		throw std::runtime_error("Cannot select a random node from an empty container.");
-	}
-
-	std::uniform_int_distribution<std::mt19937::result_type> dist(0, nodes.size() - 1);
-
-	auto iter = nodes.begin();
-
-	std::advance(iter, dist(_rng));
-
-	return iter->second;
-}
-
 template<typename Container>
-auto Mcts::randomChoice(const Container &container) -> decltype(*std::begin(container)) {
+auto Mcts::randomChoice(SearchContext &context, const Container &container) -> decltype(*std::begin(container)) {
 	if (container.empty()) {
 		throw std::runtime_error("Cannot select a random element from an empty container.");
 	}
@@ -37,18 +26,15 @@ auto Mcts::randomChoice(const Container &container) -> decltype(*std::begin(cont
 		return *std::begin(container);
 	}
 
-	// Get a random index
-	std::uniform_int_distribution<std::mt19937::result_type> dist(
-		0, std::distance(container.begin(), container.end()) - 1);
-
-	// Advance the iterator to the random index
+	// Advance the iterator to a random index
 	auto it = container.begin();
-	std::advance(it, dist(_rng));
+	std::advance(it, context.rng.below(static_cast<std::uint32_t>(std::distance(container.begin(), container.end()))));
 	return *it;
 }
 
-Action Mcts::weightedChoice(const std::vector<Action> &actions) {
-	_actionWeights.resize(actions.size());
+Action Mcts::weightedChoice(SearchContext &context, const std::vector<Action> &actions) {
+	auto &actionWeights = context.actionWeights;
+	actionWeights.resize(actions.size());
 	if (actions.empty()) {
 		throw std::runtime_error("Cannot select a random action from an empty container.");
 	}
@@ -61,42 +47,42 @@ Action Mcts::weightedChoice(const std::vector<Action> &actions) {
 			case Action::none:
 				throw std::runtime_error("Cannot choose none as an action.");
 			case Action::buildWorker:
-				_actionWeights[i] = 22.0;
+				actionWeights[i] = 22.0;
 				break;
 			case Action::buildHouse:
-				_actionWeights[i] = 1.0;
+				actionWeights[i] = 1.0;
 				break;
 			case Action::buildBase:
-				_actionWeights[i] = 1.0;
+				actionWeights[i] = 1.0;
 				break;
 			case Action::buildVespeneCollector:
-				_actionWeights[i] = 2.0;
+				actionWeights[i] = 2.0;
 				break;
 			case Action::buildBarracks:
-				_actionWeights[i] = 3.0;
+				actionWeights[i] = 3.0;
 				break;
 			case Action::buildMarine:
-				_actionWeights[i] = 15.0;
+				actionWeights[i] = 15.0;
 				break;
 			case Action::buildFactory:
-				_actionWeights[i] = 2.0;
+				actionWeights[i] = 2.0;
 				break;
 			case Action::buildTank:
-				_actionWeights[i] = 5.0;
+				actionWeights[i] = 5.0;
 				break;
 			case Action::buildViking:
-				_actionWeights[i] = 5.0;
+				actionWeights[i] = 5.0;
 				break;
 			case Action::buildStarPort:
-				_actionWeights[i] = 2.0;
+				actionWeights[i] = 2.0;
 				break;
 			default:
 				throw std::runtime_error("Cannot choose " + actionToString(actions[i]) + " as an action.");;
 		}
 	}
 
-	std::discrete_distribution<int> dist(_actionWeights.begin(), _actionWeights.end());
-	const auto index = dist(_rng);
+	std::discrete_distribution<int> dist(actionWeights.begin(), actionWeights.end());
+	const auto index = dist(context.rng);
 
 	return actions[index];
 }
@@ -111,96 +97,149 @@ double Mcts::calculateTotalWinProbability(const std::vector<double> &winProbabil
 
 	// Each "win" probability belongs to a single state
 	// Loops over each win probability, and sums the probability of that state being reached and the bot wins
-	for (int i = 0; i < arrSize; ++i) {
-		double winProb = winProbabilities[i];
-
-		//Multiply the "win" probability with the "continue" probabilities required to get to the state
-		for (int j = 0; j < i; ++j) {
-			winProb *= continueProbabilities[j];
-		}
-
-		summedWinProb += winProb;
+	// The probability of reaching the state is the product of the "continue" probabilities before it, kept running
+	double reachProb = 1.0;
+	for (size_t i = 0; i < arrSize; ++i) {
+		summedWinProb += winProbabilities[i] * reachProb;
+		reachProb *= continueProbabilities[i];
 	}
 
 	return summedWinProb;
 }
 
-std::vector<std::shared_ptr<Node> > Mcts::getMaxNodes(std::map<Action, std::shared_ptr<Node> > &children) {
-	if (children.empty()) {
+Sc2::StaticVector<Action, ACTION_COUNT> Mcts::getMaxActions(SearchContext &context, const Node &node,
+                                                            const std::uint16_t actions) const {
+	if (!node.isExpanded()) {
 		return {};
 	}
 	auto maxValue = static_cast<double>(-INFINITY);
-	std::vector<std::shared_ptr<Node> > maxNodes = {};
+	StaticVector<Action, ACTION_COUNT> maxActions = {};
 
-	for (const auto &child: std::ranges::views::values(children)) {
-		const auto childValue = value(child);
+	for (auto mask = static_cast<std::uint16_t>(node.getActionMask() & actions); mask != 0; mask &= mask - 1) {
+		const auto action = static_cast<Action>(std::countr_zero(mask));
+		const auto childValue = value(context, node.getChild(action));
 		if (childValue > maxValue) {
-			maxNodes.clear();
-			maxNodes.push_back(child);
+			maxActions.clear();
+			maxActions.push_back(action);
 			maxValue = childValue;
 		} else if (childValue == maxValue) {
-			maxNodes.push_back(child);
+			maxActions.push_back(action);
 		}
 	}
-	return maxNodes;
+	return maxActions;
 }
 
 
-std::shared_ptr<Node> Mcts::selectNode() {
+Node *Mcts::selectNode(SearchContext &context) {
 	auto node = _rootNode;
+	node->addVirtualLoss(context.virtualLoss);
 
-	while (!node->children.empty()) {
-		std::vector<std::shared_ptr<Node> > maxNodes = getMaxNodes(node->children);
+	while (node->isExpanded()) {
+		const auto action = randomChoice(context, getMaxActions(context, *node));
+		// Once the tree has reached the memory budget no more children are built, the search rolls out from here
+		if (node->getChild(action) == nullptr && atMemoryBudget()) {
+			return node;
+		}
 
-		node = randomChoice(maxNodes);
+		node = node->getOrAddChild(action);
+		node->addVirtualLoss(context.virtualLoss);
 
-		if (node->N == 0) {
+		if (node->getVisits() == 0) {
 			return node;
 		}
 	}
 
-	if (!node->gameOver()) {
+	if (!node->gameOver() && !atMemoryBudget()) {
 		node->expand();
-		if (!node->children.empty()) {
-			node = randomChoice(node->children);
+		if (node->isExpanded()) {
+			node = node->getOrAddChild(randomChoice(context, node->getChildActions()));
+			node->addVirtualLoss(context.virtualLoss);
 		}
 	}
 
 	return node;
 }
 
+Node *Mcts::selectOpenLoop(SearchContext &context) {
+	auto node = _rootNode;
+	node->addVirtualLoss(context.virtualLoss);
+	auto &state = context.state.emplace(node->copyState());
+	state.splitRandomStreams(context.rng);
+	context.path.clear();
+
+	auto gameOver = state.GameOver();
+	while (!gameOver) {
+		const auto legalActions = state.getLegalActions();
+		if (legalActions[0] == Action::none) {
+			break;
+		}
+		node->addChildren(legalActions);
+		std::uint16_t legal = 0;
+		for (const auto action: legalActions) {
+			legal |= actionBit(action);
+		}
 
-double Mcts::rollout(const std::shared_ptr<Node> &node) {
-	const auto state = State::DeepCopy(*node->getState(), true);
-	std::vector<double> winProbabilities;
-	// std::vector<double> lossProbabilities;
-	std::vector<double> continueProbabilities;
+		const auto action = randomChoice(context, getMaxActions(context, *node, legal));
+		if (node->getChild(action) == nullptr && atMemoryBudget()) {
+			break;
+		}
+		node = node->getOrAddChild(action);
+		node->addVirtualLoss(context.virtualLoss);
 
-	while (!state->GameOver()) {
-		auto legalActions = state->getLegalActions();
+		state.performAction(action);
+		const auto evaluation = state.evaluate();
+		context.path.push_back(State::getWinProbabilities(evaluation));
+		gameOver = state.GameOver(evaluation);
+
+		if (node->getVisits() == 0) {
+			break;
+		}
+	}
+	return node;
+}
+
+double Mcts::rollout(SearchContext &context, Node *node) const {
+	// A plain copy of the flat State, the rollout never needs shared ownership of it
+	return rollout(context, node->copyState());
+}
+
+double Mcts::rollout(SearchContext &context, State state) const {
+	// The buffers of the context keep their capacity, so a rollout does not allocate them again
+	auto &winProbabilities = context.winProbabilities;
+	auto &continueProbabilities = context.continueProbabilities;
+	winProbabilities.clear();
+	continueProbabilities.clear();
+
+	// Evaluating the state after each action also tells whether the game is over, so it is only evaluated once
+	auto gameOver = state.GameOver();
+	while (!gameOver) {
+		auto legalActions = state.getLegalActions();
 
 		if (legalActions[0] == Action::none) {
-			state->wait();
+			state.wait();
+			gameOver = state.GameOver();
 			continue;
 		}
 
 		Action action;
 		switch (_rolloutHeuristic) {
 			case RolloutHeuristic::Random:
-				action = randomChoice(legalActions);
+				action = randomChoice(context, legalActions);
 				break;
 			case RolloutHeuristic::WeightedChoice:
-				action = weightedChoice(legalActions);
+				action = weightedChoice(context, legalActions);
 				break;
 			default:
 				throw std::runtime_error("Invalid rollout heuristic.");
 		}
 
-		state->performAction(action);
+		state.performAction(action);
 
-		const auto [winProb, _, continueProb] = state->getWinProbabilities();
+		const auto evaluation = state.evaluate();
+		const auto [winProb, _, continueProb] = State::getWinProbabilities(evaluation);
 		winProbabilities.emplace_back(winProb);
 		continueProbabilities.emplace_back(continueProb);
+		gameOver = state.GameOver(evaluation);
 	}
 
 	if (!winProbabilities.empty() && !continueProbabilities.empty()) {
@@ -213,66 +252,203 @@ double Mcts::rollout(const std::shared_ptr<Node> &node) {
 	return calculateTotalWinProbability(winProbabilities, continueProbabilities);
 }
 
-void Mcts::backPropagate(std::shared_ptr<Node> node, double outcome) {
+void Mcts::backPropagate(Node *node, double outcome, const int virtualLoss) {
 	while (node != nullptr) {
 		const auto [winProb, _, continueProb] = node->winProbabilities;
 		outcome = winProb * 1 + continueProb * outcome;
 
-		const auto oldMean = node->N == 0 ? 0 : node->Q / node->N;
+		node->update(outcome, virtualLoss);
 
-		node->N += 1;
-		node->Q += outcome;
+		node = node->getParent();
+	}
+}
+
+void Mcts::backPropagate(Node *node, Outcomes outcomes, const int virtualLoss) {
+	while (node != nullptr) {
+		const auto [winProb, _, continueProb] = node->winProbabilities;
+		outcomes = outcomes.transformed(winProb, continueProb);
 
-		const auto newMean = node->Q / node->N;
-		const auto delta = outcome - oldMean;
-		// M2 is updated using Welfords online algorithm
-		node->M2 += delta * (outcome - newMean);
+		node->update(outcomes, virtualLoss);
 
 		node = node->getParent();
 	}
 }
 
-void Mcts::singleSearch() {
-	const auto node = selectNode();
-	const auto outcome = rollout(node);
-	backPropagate(node, outcome);
-	_numberOfRollouts++;
+void Mcts::backPropagatePath(const SearchContext &context, Node *node, Outcomes outcomes) const {
+	for (auto probabilities = context.path.rbegin(); probabilities != context.path.rend(); ++probabilities) {
+		const auto [winProb, _, continueProb] = *probabilities;
+		outcomes = outcomes.transformed(winProb, continueProb);
+		node->update(outcomes, context.virtualLoss);
+		node = node->getParent();
+	}
+	// Only the root keeps its state, and the probabilities of it
+	backPropagate(node, outcomes, context.virtualLoss);
 }
 
-void Mcts::threadedSearch() {
+Outcomes Mcts::rollouts(SearchContext &context, const State &state) {
+	std::vector<double> outcomes(_rolloutsPerLeaf);
+	std::vector<std::exception_ptr> errors(_rolloutsPerLeaf);
+	const auto run = [this, &state, &outcomes, &errors](SearchContext &rolloutContext, const int i) {
+		try {
+			outcomes[i] = rollout(rolloutContext, state);
+		} catch (...) {
+			errors[i] = std::current_exception();
+		}
+	};
+
+	// The workers take every rollout but the first, which the searching thread runs while it waits for them
+	const auto shared = _rolloutWorkers != nullptr ? _rolloutsPerLeaf - 1 : 0;
+	std::latch done(shared);
+	for (int i = 1; i <= shared; i++) {
+		_rolloutWorkers->submit([this, i, &run, &done](const int worker) {
+			run(_rolloutContexts[worker], i);
+			done.count_down();
+		});
+	}
+	for (int i = shared + 1; i < _rolloutsPerLeaf; i++) {
+		run(context, i);
+	}
+	run(context, 0);
+	done.wait();
+
+	Outcomes batch;
+	for (int i = 0; i < _rolloutsPerLeaf; i++) {
+		if (errors[i] != nullptr) {
+			std::rethrow_exception(errors[i]);
+		}
+		batch.add(outcomes[i]);
+	}
+	return batch;
+}
+
+void Mcts::setLeafParallelism(const int rolloutsPerLeaf, const int workers) {
+	if (rolloutsPerLeaf < 1 || workers < 0) {
+		throw std::invalid_argument("Leaf parallelism needs at least one rollout per leaf and no negative workers.");
+	}
+	RequestGuard guard(*this, Request::setLeafParallelism);
+	_rolloutWorkers.reset();
+	_rolloutsPerLeaf = rolloutsPerLeaf;
+	_rolloutContexts = std::vector<SearchContext>(workers);
+	auto stream = _context.rng.split();
+	for (auto &context: _rolloutContexts) {
+		context.rng = stream;
+		stream.jump();
+	}
+	if (workers > 0 && rolloutsPerLeaf > 1) {
+		_rolloutWorkers = std::make_unique<WorkerPool>(workers);
+	}
+}
+
+void Mcts::singleSearch(SearchContext &context) {
+	if (_nodes.isOpenLoop()) {
+		const auto node = selectOpenLoop(context);
+		Outcomes outcomes;
+		if (_rolloutsPerLeaf == 1) {
+			outcomes.add(rollout(context, *context.state));
+		} else {
+			outcomes = rollouts(context, *context.state);
+		}
+		backPropagatePath(context, node, outcomes);
+		_numberOfRollouts += outcomes.count;
+		return;
+	}
+
+	const auto node = selectNode(context);
+	if (_rolloutsPerLeaf == 1) {
+		const auto outcome = rollout(context, node);
+		backPropagate(node, outcome, context.virtualLoss);
+		++_numberOfRollouts;
+		return;
+	}
+	const auto outcomes = rollouts(context, node->copyState());
+	backPropagate(node, outcomes, context.virtualLoss);
+	_numberOfRollouts += outcomes.count;
+}
+
+void Mcts::setOpenLoop(const bool openLoop) {
+	RequestGuard guard(*this, Request::setOpenLoop);
+	if (openLoop == _nodes.isOpenLoop()) {
+		return;
+	}
+	auto rootState = std::make_shared<State>(_rootNode->copyState());
+	_nodes.setOpenLoop(openLoop);
+	replaceRoot(std::move(rootState));
+}
+
+void Mcts::waitForRequests() {
+	std::unique_lock lock(_requestMutex);
+	_requestsHandled.wait(lock, [this] { return _pendingRequests == 0; });
+}
+
+void Mcts::threadedSearch(SearchContext &context) {
 	while (_running) {
-		if (!_mctsRequestsPending) {
-			_mctsMutex.lock();
-			singleSearch();
-			_mctsMutex.unlock();
+		adoptPostedRoot();
+		pruneToMemoryBudget();
+		waitForRequests();
+		std::shared_lock lock(_mctsMutex);
+		// A pending request gets the lock as soon as the current search is done
+		for (int i = 0; i < _searchBatch && _running && _pendingRequests == 0; i++) {
+			singleSearch(context);
 		}
+		publishSnapshot();
 	}
 }
 
-void Mcts::threadedSearchRollout(const int numberOfRollouts) {
+void Mcts::threadedSearchRollout(SearchContext &context, const unsigned int numberOfRollouts) {
 	while (_numberOfRollouts < numberOfRollouts) {
-		if (!_mctsRequestsPending) {
-			_mctsMutex.lock();
-			singleSearch();
-			_mctsMutex.unlock();
+		adoptPostedRoot();
+		pruneToMemoryBudget();
+		waitForRequests();
+		std::shared_lock lock(_mctsMutex);
+		for (int i = 0; i < _searchBatch && _numberOfRollouts < numberOfRollouts && _pendingRequests == 0; i++) {
+			singleSearch(context);
 		}
+		publishSnapshot();
 	}
 }
 
+void Mcts::startSearchThreads(const int threads, const std::function<void(SearchContext &)> &search) {
+	if (threads < 1) {
+		throw std::invalid_argument("The search needs at least one thread.");
+	}
+	_running = true;
+	_searchContexts = std::vector<SearchContext>(threads);
+	// Jumping a stream split off once gives every thread its own stream, without touching the ones below the root
+	auto stream = _context.rng.split();
+	for (auto &context: _searchContexts) {
+		context.rng = stream;
+		context.virtualLoss = threads > 1 ? 1 : 0;
+		stream.jump();
+	}
+	_activeSearchThreads = threads;
+	for (auto &context: _searchContexts) {
+		_searchThreads.emplace_back([this, search, &context] {
+			search(context);
+			// The last thread to stop adopts a root posted while it was stopping, which nothing else would
+			--_activeSearchThreads;
+			adoptPostedRoot();
+		});
+	}
+}
 
 void Mcts::stopSearchThread() {
 	_running = false;
-	_searchThread.join();
+	for (auto &thread: _searchThreads) {
+		thread.join();
+	}
+	_searchThreads.clear();
 }
 
-void Mcts::startSearchRolloutThread(int numberOfRollouts) {
-	_running = true;
-	_searchThread = std::thread(&Mcts::threadedSearchRollout, this, numberOfRollouts);
+void Mcts::startSearchRolloutThread(const int numberOfRollouts, const int threads) {
+	// A negative number of rollouts is already reached, rather than wrapping around to a search without end
+	const auto target = static_cast<unsigned int>(std::max(numberOfRollouts, 0));
+	startSearchThreads(threads, [this, target](SearchContext &context) {
+		threadedSearchRollout(context, target);
+	});
 }
 
-void Mcts::startSearchThread() {
-	_running = true;
-	_searchThread = std::thread(&Mcts::threadedSearch, this);
+void Mcts::startSearchThread(const int threads) {
+	startSearchThreads(threads, [this](SearchContext &context) { threadedSearch(context); });
 }
 
 void Mcts::search(const int timeLimit) {
@@ -281,67 +457,74 @@ void Mcts::search(const int timeLimit) {
 
 	while (duration_cast<milliseconds>(system_clock::now().time_since_epoch())
 	       .count() < endTime) {
-		singleSearch();
+		pruneToMemoryBudget();
+		singleSearch(_context);
 	}
+	publishSnapshot();
 }
 
 void Mcts::searchRollout(const int rollouts) {
-	for (int i = 0; i < rollouts; i++) {
-		singleSearch();
+	// A search can run several rollouts at once, so it is the rollouts that are counted rather than the searches
+	const auto target = _numberOfRollouts + rollouts;
+	while (_numberOfRollouts < target) {
+		pruneToMemoryBudget();
+		singleSearch(_context);
 	}
+	publishSnapshot();
 }
 
 // Upper confidence bound applied to trees
 // Q/N + C * (sqrt(log(parent.N/N)
-double Mcts::uct(const std::shared_ptr<Node> &node) const {
-	return node->Q / static_cast<float>(node->N) + EXPLORATION * sqrt(
-		       log(static_cast<double>(node->getParent()->N) / static_cast<double>(node->N)));
+// Simulations still in progress count as visits that were lost, for the node and its parent alike
+double Mcts::uct(const Node *node) const {
+	const auto visits = node->getEffectiveVisits();
+	return node->getMeanValue() + EXPLORATION * sqrt(
+		       log(static_cast<double>(node->getParent()->getEffectiveVisits()) / static_cast<double>(visits)));
 }
 
 // Upper confidence bound normalized
-double Mcts::ucb1Normal2(const std::shared_ptr<Node> &node) {
+// The variance and the trials only count finished simulations, virtual loss only lowers the mean
+double Mcts::ucb1Normal2(const Node *node) {
 	// If the node has not been explored at least twice we will divide by 0 when getting the variance
-	if (node->N < 2) {
+	if (node->getVisits() < 2) {
 		return INFINITY;
 	}
 
-	const double totalTrials = node->getParent()->N;
-	const double trials = node->N;
-	const auto mean = node->Q / trials;
+	const double totalTrials = node->getParent()->getVisits();
+	const auto mean = node->getMeanValue();
 	const auto variance = node->getSampleVariance();
 
 	return mean + variance * sqrt(2 * std::log(totalTrials));
 }
 
-double Mcts::ucb1Normal(const std::shared_ptr<Node> &node) {
-	if (node->N < 2) {
+double Mcts::ucb1Normal(const Node *node) {
+	if (node->getVisits() < 2) {
 		return INFINITY;
 	}
-	const auto totalTrials = node->getParent()->N;
-	const auto trials = node->N;
+	const auto totalTrials = node->getParent()->getVisits();
+	const auto trials = node->getVisits();
 	const auto variance = node->getSampleVariance();
-	const auto mean = node->Q / trials;
+	const auto mean = node->getMeanValue();
 	return mean + variance * std::sqrt((16 * std::log(totalTrials - 1)) / trials);
 }
 
-double Mcts::epsilonGreedy(const std::shared_ptr<Node> &node) {
-	if (node->N < 1) {
+double Mcts::epsilonGreedy(SearchContext &context, const Node *node) const {
+	if (node->getEffectiveVisits() < 1) {
 		return INFINITY;
 	}
 
-	std::uniform_real_distribution<float> dist(0.0f, 1.0f);
-
-	if (dist(_rng) > EXPLORATION) {
+	if (context.rng.uniform() > EXPLORATION) {
 		//exploit
-		return node->Q / node->N;
+		return node->getMeanValue();
 	} else {
 		// explore
 		return INFINITY;
 	}
 }
 
-double Mcts::value(const std::shared_ptr<Node> &node) {
-	if (node->N == 0) {
+double Mcts::value(SearchContext &context, const Node *node) const {
+	// A child that has not been built yet has not been visited either
+	if (node == nullptr || node->getEffectiveVisits() == 0) {
 		if (EXPLORATION == 0) {
 			return 0;
 		}
@@ -356,7 +539,7 @@ double Mcts::value(const std::shared_ptr<Node> &node) {
 		case ValueHeuristic::UCB1Normal:
 			return ucb1Normal(node);
 		case ValueHeuristic::EpsilonGreedy:
-			return epsilonGreedy(node);
+			return epsilonGreedy(context, node);
 		default:
 			return 0;
 	}
@@ -364,82 +547,317 @@ double Mcts::value(const std::shared_ptr<Node> &node) {
 
 
 void Mcts::performAction(const Action action) {
-	_mctsRequestsPending = true;
-	_mctsMutex.lock();
+	RequestGuard guard(*this, Request::performAction);
+	performRootAction(action);
+}
 
-	// Check if the action matches any explored nodes
-	for (const auto childAction: _rootNode->children | std::views::keys) {
-		if (childAction == action) {
-			_rootNode = _rootNode->children[action];
-			_rootNode->setParent(nullptr);
-			_mctsMutex.unlock();
-			_mctsRequestsPending = false;
+void Mcts::performRootAction(const Action action) {
+	// The nodes of an open loop tree have no state, the new root gets one by taking the action in the root state
+	if (_nodes.isOpenLoop()) {
+		const auto actions = _rootNode->getState()->getLegalActions();
+		if (std::ranges::find(actions, action) == actions.end()) {
+			std::cout << "action not found: " << action << std::endl;
 			return;
 		}
+		auto state = std::make_shared<State>(_rootNode->copyState());
+		state->performAction(action);
+		// Without a child for the action nothing of the tree applies to the new root
+		const auto child = _rootNode->getChild(action);
+		if (child == nullptr) {
+			replaceRoot(std::move(state));
+			return;
+		}
+		_nodes.setState(*child, std::move(state));
+		moveRoot(*child);
+		_rootVersion++;
+		publishSnapshot();
+		return;
+	}
+
+	// Check if the action matches any explored nodes
+	if (const auto child = _rootNode->getOrAddChild(action); child != nullptr) {
+		moveRoot(*child);
+		_rootVersion++;
+		publishSnapshot();
+		return;
 	}
 
 	auto actions = _rootNode->getState()->getLegalActions();
 	if (std::ranges::find(actions, action) != actions.end()) {
 		_rootNode->getState()->performAction(action);
-		_mctsMutex.unlock();
-		_mctsRequestsPending = false;
+		_rootVersion++;
+		publishSnapshot();
 		return;
 	}
 	std::cout << "action not found: " << action << std::endl;
-	_mctsMutex.unlock();
-	_mctsRequestsPending = false;
 }
 
 Action Mcts::getBestAction() {
-	_mctsRequestsPending = true;
-	_mctsMutex.lock();
+	const auto snapshot = _snapshot.load();
 
-	if (_rootNode->children.empty()) {
-		_mctsMutex.unlock();
-		_mctsRequestsPending = false;
-		return Action::none;
-	}
-
-	auto bestNode = _rootNode->children.begin()->second;
-	double maxValue = bestNode->Q / bestNode->N;
-	std::vector<std::shared_ptr<Node> > maxNodes = {};
-
-	for (const auto &child: std::ranges::views::values(_rootNode->children)) {
-		// only give an action if all children has been explored once
-		if (child->N < 1) {
-			maxNodes.clear();
-			break;
+	auto maxValue = static_cast<double>(-INFINITY);
+	StaticVector<Action, ACTION_COUNT> maxActions = {};
+	for (const auto &[action, visits, totalValue]: snapshot->actions) {
+		// only give an action if all children has been explored once, unbuilt children included
+		if (visits < 1) {
+			return Action::none;
 		}
 
-		const auto childValue = child->Q / child->N;
+		const auto childValue = totalValue / visits;
 		if (childValue > maxValue) {
-			maxNodes.clear();
-			maxNodes.push_back(child);
+			maxActions.clear();
+			maxActions.push_back(action);
 			maxValue = childValue;
 		} else if (childValue == maxValue) {
-			maxNodes.push_back(child);
+			maxActions.push_back(action);
 		}
 	}
 
-	_mctsMutex.unlock();
-	_mctsRequestsPending = false;
-
-	if (maxNodes.empty()) {
+	if (maxActions.empty()) {
 		return Action::none;
 	}
+	return randomChoice(_context, maxActions);
+}
 
-	bestNode = randomChoice(maxNodes);
-	return bestNode->getAction();
+void Mcts::publishSnapshot() {
+	auto snapshot = std::make_shared<SearchSnapshot>();
+	for (const auto action: _rootNode->getChildActions()) {
+		if (const auto child = _rootNode->getChild(action); child != nullptr) {
+			snapshot->actions.push_back({action, child->getVisits(), child->getTotalValue()});
+		} else {
+			snapshot->actions.push_back({action, 0, 0});
+		}
+	}
+	snapshot->rollouts = _numberOfRollouts;
+	snapshot->rootVersion = _rootVersion;
+
+	// The root state stays the same while the root does, apart from the random streams its children split off
+	if (const auto previous = _snapshot.load(); previous != nullptr && previous->rootVersion == _rootVersion) {
+		snapshot->rootState = previous->rootState;
+	} else {
+		snapshot->rootState = std::make_shared<State>(_rootNode->copyState());
+	}
+	_snapshot.store(std::move(snapshot));
 }
 
 void Mcts::updateRootState(const std::shared_ptr<State> &state) {
-	_mctsRequestsPending = true;
-	_mctsMutex.lock();
 	auto rootState = State::DeepCopy(*state);
+	RequestGuard guard(*this, Request::updateRootState);
+	reuseOrReplaceRoot(std::move(rootState));
+}
+
+std::uint64_t Mcts::postRootState(const std::shared_ptr<State> &state, const std::vector<Action> &actions) {
+	auto rootState = State::DeepCopy(*state);
+	std::uint64_t sequence;
+	{
+		std::lock_guard lock(_mailboxMutex);
+		// A root that has not been adopted yet is replaced, only the latest one matters
+		_mailbox = PostedRoot{std::move(rootState), actions};
+		sequence = ++_postedRoots;
+	}
+	// Without search threads to adopt it, the root is adopted right away
+	if (_activeSearchThreads == 0) {
+		adoptPostedRoot();
+	}
+	return sequence;
+}
+
+void Mcts::adoptPostedRoot() {
+	if (_adoptedRoots == _postedRoots) {
+		return;
+	}
+	RequestGuard guard(*this, Request::adoptRootState);
+	std::optional<PostedRoot> posted;
+	std::uint64_t sequence;
+	{
+		std::lock_guard lock(_mailboxMutex);
+		posted.swap(_mailbox);
+		sequence = _postedRoots;
+	}
+	// Another thread adopted it first
+	if (!posted.has_value()) {
+		return;
+	}
+
+	reuseOrReplaceRoot(std::move(posted->state));
+	for (const auto action: posted->actions) {
+		performRootAction(action);
+	}
+	{
+		std::lock_guard lock(_mailboxMutex);
+		_adoptedRoots = sequence;
+	}
+	_rootAdopted.notify_all();
+}
+
+void Mcts::waitForRoot(const std::uint64_t sequence) {
+	std::unique_lock lock(_mailboxMutex);
+	_rootAdopted.wait(lock, [this, sequence] { return _adoptedRoots >= sequence; });
+}
+
+void Mcts::reuseOrReplaceRoot(std::shared_ptr<State> rootState) {
+	_treeReuse.attempts++;
+	Node *match = nullptr;
+	const auto consider = [&](Node *node) {
+		// The nodes below the root of an open loop tree have no state to match
+		if ((match == nullptr || node->getVisits() > match->getVisits()) && node->getState() != nullptr &&
+		    node->getState()->matches(*rootState, _reuseTolerance)) {
+			match = node;
+		}
+	};
+	consider(_rootNode);
+	for (const auto child: _rootNode->getChildren()) {
+		consider(child);
+		for (const auto grandchild: child->getChildren()) {
+			consider(grandchild);
+		}
+	}
+
+	if (match == nullptr) {
+		replaceRoot(std::move(rootState));
+		return;
+	}
+	_treeReuse.hits++;
+	_treeReuse.reusedVisits += match->getVisits();
+	if (match != _rootNode) {
+		moveRoot(*match);
+	}
+	// The search carries over, so the rollouts count the ones already run from the new root
+	_numberOfRollouts = match->getVisits();
+	_rootVersion++;
+	publishSnapshot();
+}
+
+void Mcts::moveRoot(Node &node) {
+	_nodes.makeRoot(node);
+	_rootNode = &node;
+	// The entries of the released nodes would keep pooling the statistics of states that can no longer be reached
+	_nodes.rebuildTranspositions(node);
+	requestReclaim();
+}
+
+void Mcts::replaceRoot(std::shared_ptr<State> rootState) {
 	rootState->setArmyValueFunction(_armyValueFunction);
 	rootState->setEndProbabilityFunction(END_PROBABILITY_FUNCTION);
-	_rootNode = std::make_shared<Node>(Node(Action::none, nullptr, std::move(rootState)));
+	// The old tree is released rather than cleared, so that its states are freed by the reclaimer
+	_nodes.release(*_rootNode);
+	_transpositions.clear();
+	_rootNode = _nodes.create(Action::none, nullptr, std::move(rootState));
 	_numberOfRollouts = 0;
-	_mctsMutex.unlock();
-	_mctsRequestsPending = false;
+	_rootVersion++;
+	publishSnapshot();
+	requestReclaim();
+}
+
+std::size_t Mcts::memoryUsage() const {
+	// A state made by make_shared shares its allocation with the control block, two counts and a vtable pointer
+	constexpr auto STATE_BYTES = sizeof(State) + 2 * sizeof(int) + sizeof(void *);
+	return _nodes.size() * sizeof(Node) + _nodes.stateCount() * STATE_BYTES +
+	       _transpositions.size() * TranspositionTable::ENTRY_BYTES;
+}
+
+void Mcts::setMemoryBudget(const std::size_t bytes) {
+	RequestGuard guard(*this, Request::setMemoryBudget);
+	_memoryBudget = bytes;
+	_unprunableRoot = 0;
+	if (atMemoryBudget()) {
+		pruneTree();
+	}
+}
+
+void Mcts::pruneToMemoryBudget() {
+	// A tree that had nothing left to prune only has more once its root has moved
+	if (!atMemoryBudget() || _unprunableRoot == _snapshot.load()->rootVersion + 1) {
+		return;
+	}
+	RequestGuard guard(*this, Request::pruneTree);
+	// Another thread may have pruned the tree while this one waited for it
+	if (atMemoryBudget() && _unprunableRoot != _rootVersion + 1) {
+		pruneTree();
+	}
+}
+
+void Mcts::pruneTree() {
+	// Released nodes count until they are reclaimed, which may be enough by itself
+	_nodes.reclaim(std::numeric_limits<std::size_t>::max());
+	const auto target = _memoryBudget / 4 * 3;
+	const auto usage = memoryUsage();
+	if (usage <= target) {
+		return;
+	}
+	// Each pruned node frees its share of the memory, its state and transposition entry included
+	const auto prune = static_cast<std::size_t>(std::ceil(static_cast<double>(usage - target) /
+	                                                      static_cast<double>(usage) *
+	                                                      static_cast<double>(_nodes.size())));
+
+	std::vector<Node *> subtrees;
+	for (const auto child: _rootNode->getChildren()) {
+		for (const auto grandchild: child->getChildren()) {
+			subtrees.push_back(grandchild);
+		}
+	}
+	std::vector<int> visits;
+	for (auto stack = subtrees; !stack.empty();) {
+		const auto node = stack.back();
+		stack.pop_back();
+		visits.push_back(node->getVisits());
+		for (const auto child: node->getChildren()) {
+			stack.push_back(child);
+		}
+	}
+	if (visits.empty()) {
+		_unprunableRoot = _rootVersion + 1;
+		return;
+	}
+	const auto rank = std::min(std::max(prune, std::size_t{1}), visits.size()) - 1;
+	std::ranges::nth_element(visits, visits.begin() + static_cast<std::ptrdiff_t>(rank));
+	const auto threshold = visits[rank];
+
+	// A node has no more visits than its parent, so the nodes at or below the threshold make up whole subtrees
+	for (auto stack = std::move(subtrees); !stack.empty();) {
+		const auto node = stack.back();
+		stack.pop_back();
+		if (node->getVisits() <= threshold) {
+			_nodes.release(*node);
+			continue;
+		}
+		for (const auto child: node->getChildren()) {
+			stack.push_back(child);
+		}
+	}
+	_prunedNodes += std::ranges::count_if(visits, [threshold](const int nodeVisits) {
+		return nodeVisits <= threshold;
+	});
+	_nodes.reclaim(std::numeric_limits<std::size_t>::max());
+	_nodes.rebuildTranspositions(*_rootNode);
+}
+
+void Mcts::requestReclaim() {
+	{
+		std::lock_guard lock(_reclaimMutex);
+		_reclaimPending = true;
+		if (!_reclaimer.joinable()) {
+			_reclaimer = std::thread([this] { reclaim(); });
+		}
+	}
+	_reclaimNeeded.notify_one();
+}
+
+void Mcts::reclaim() {
+	// Nodes reclaimed at a time, small enough that the pool is never held long by it
+	constexpr std::size_t RECLAIM_CHUNK = 256;
+	std::unique_lock lock(_reclaimMutex);
+	while (true) {
+		_reclaimNeeded.wait(lock, [this] { return _reclaimPending || _stopReclaiming; });
+		if (_stopReclaiming) {
+			return;
+		}
+		_reclaimPending = false;
+		lock.unlock();
+		while (_nodes.reclaim(RECLAIM_CHUNK) != 0) {
+			// Leaves the core to the search between chunks
+			std::this_thread::yield();
+		}
+		lock.lock();
+	}
 }
@@ -4,14 +4,26 @@
 
 #ifndef MCTS_H
 #define MCTS_H
+#include <cstdint>
+#include <functional>
+#include <optional>
 #include <random>
 #include <utility>
 #include <Sc2State.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <thread>
+#include <tuple>
 #include <mutex>
+#include <shared_mutex>
 #include <sstream>
 
 #include "Node.h"
+#include "RequestLatency.h"
+#include "TranspositionTable.h"
+#include "WorkerPool.h"
 #include "ValueHeuristicEnum.h"
 #include "RolloutHeuristicEnum.h"
 
@@ -20,103 +32,391 @@ namespace Sc2::Mcts {
 	class Node;
 
 	class Mcts {
-		std::mt19937 _rng;
+	public:
+		// The statistics of one of the root's actions
+		struct ActionStatistics {
+			Action action = Action::none;
+			int visits = 0;
+			double totalValue = 0;
+		};
+
+		// The results of the search, published by the search threads after every batch of searches so that they
+		// can be read without waiting for the search. It is never changed once published.
+		struct SearchSnapshot {
+			StaticVector<ActionStatistics, ACTION_COUNT> actions;
+			unsigned int rollouts = 0;
+			// A copy of the root state, taken again only once the root has changed
+			std::shared_ptr<State> rootState;
+			unsigned int rootVersion = 0;
+		};
+
+		// How often a new root state matched a node of the tree, which then became the root with its statistics
+		struct TreeReuse {
+			std::uint64_t attempts = 0;
+			std::uint64_t hits = 0;
+			// The visits of the reused nodes, summed
+			std::uint64_t reusedVisits = 0;
+
+			[[nodiscard]] double hitRate() const {
+				return attempts == 0 ? 0 : static_cast<double>(hits) / static_cast<double>(attempts);
+			}
+		};
+
+		// The memory the tree takes, counting released nodes until their states have been freed
+		struct TreeMemory {
+			std::size_t nodes = 0;
+			// The nodes that have a state of their own
+			std::size_t states = 0;
+			std::size_t transpositions = 0;
+			// An estimate from the sizes of the nodes, their states and the transposition entries
+			std::size_t bytes = 0;
+			// Covers the bytes only, no budget is 0
+			std::size_t budget = 0;
+			// The chunks the nodes are allocated in and the pool's own lists, which are kept once the tree shrinks
+			std::size_t reservedBytes = 0;
+			// The nodes pruned to keep the tree within the budget, summed
+			std::uint64_t prunedNodes = 0;
+		};
+
+	private:
+		// The state a single search thread needs for itself, kept on its own cache line
+		struct alignas(64) SearchContext {
+			Rng rng;
+			std::vector<double> actionWeights = std::vector<double>(10);
+			// The win and continue probabilities of the states a rollout passes through
+			std::vector<double> winProbabilities;
+			std::vector<double> continueProbabilities;
+			// The state an open loop search simulates along the selected path, with a fresh sample of the enemy
+			std::optional<State> state;
+			// The win, loss and continue probabilities of the simulated states below the root, in path order
+			std::vector<std::tuple<double, double, double> > path;
+			// Added to the nodes on the selected path until the outcome is backpropagated, so that the other
+			// threads searching the same tree are steered elsewhere
+			int virtualLoss = 0;
+		};
+
+		// The context of searches run from the calling thread
+		SearchContext _context;
 
 		const double EXPLORATION = sqrt(2);
 		int _rolloutEndTime = 100;
 		ValueHeuristic _valueHeuristic = ValueHeuristic::UCT;
 		RolloutHeuristic _rolloutHeuristic = RolloutHeuristic::Random;
 
-		std::shared_ptr<Node> _rootNode;
+		// The statistics shared by nodes with the same state, which makes the search a graph rather than a tree
+		TranspositionTable _transpositions;
+		NodePool _nodes{&_transpositions};
+		Node *_rootNode = nullptr;
 		int _runTime = 0;
-		int _nodeCount = 0;
-		unsigned int _numberOfRollouts = 0;
-
-		std::thread _searchThread;
-		std::mutex _mctsMutex;
+		std::atomic<unsigned int> _numberOfRollouts = 0;
+
+		std::vector<std::thread> _searchThreads;
+		// A context per search thread, sized before the threads start so that they never move
+		std::vector<SearchContext> _searchContexts;
+		// Rollouts run from each selected node, the ones beyond the first on the rollout workers if there are any
+		int _rolloutsPerLeaf = 1;
+		std::unique_ptr<WorkerPool> _rolloutWorkers;
+		// A context per rollout worker
+		std::vector<SearchContext> _rolloutContexts;
+		// Search threads share the tree and hold the lock shared, requests from outside hold it exclusively
+		std::shared_mutex _mctsMutex;
 		std::atomic<bool> _running = false;
-		std::atomic<bool> _mctsRequestsPending;
+		// Search threads let go of the tree while requests are pending, and sleep until they have been handled
+		std::atomic<int> _pendingRequests = 0;
+		std::mutex _requestMutex;
+		std::condition_variable _requestsHandled;
+		// The searches a search thread runs each time it takes the lock
+		int _searchBatch = 16;
+		std::array<LatencyRecorder, REQUEST_TYPES> _latencies;
+
+		std::atomic<std::shared_ptr<const SearchSnapshot> > _snapshot;
+		// Changed by every request that changes the root, which is when the snapshot needs a new root state
+		unsigned int _rootVersion = 0;
+
+		// Publishes the current results, the tree must be held shared or exclusively
+		void publishSnapshot();
+
+		// A root state posted from outside the search, with the actions to take from it once it is adopted
+		struct PostedRoot {
+			std::shared_ptr<State> state;
+			std::vector<Action> actions;
+		};
+
+		// A single slot, which search threads check between batches of searches
+		std::optional<PostedRoot> _mailbox;
+		std::mutex _mailboxMutex;
+		std::condition_variable _rootAdopted;
+		std::atomic<std::uint64_t> _postedRoots = 0;
+		std::atomic<std::uint64_t> _adoptedRoots = 0;
+		std::atomic<int> _activeSearchThreads = 0;
+
+		// Frees the states of released subtrees on a thread of its own, so that requests do not wait for it
+		std::thread _reclaimer;
+		std::mutex _reclaimMutex;
+		std::condition_variable _reclaimNeeded;
+		bool _reclaimPending = false;
+		bool _stopReclaiming = false;
+
+		// Wakes the reclaimer, starting it the first time a subtree is released
+		void requestReclaim();
+		void reclaim();
+
+		StateTolerance _reuseTolerance;
+		TreeReuse _treeReuse;
+
+		// Read by the search threads without the lock, to stop building nodes once the tree has reached it
+		std::atomic<std::size_t> _memoryBudget = 0;
+		std::atomic<std::uint64_t> _prunedNodes = 0;
+		// One past the root version whose tree had nothing left to prune, 0 if pruning may still free memory
+		std::atomic<unsigned int> _unprunableRoot = 0;
+
+		[[nodiscard]] std::size_t memoryUsage() const;
+		[[nodiscard]] bool atMemoryBudget() const {
+			const auto budget = _memoryBudget.load();
+			return budget != 0 && memoryUsage() >= budget;
+		}
+		/*
+		 * Releases the subtrees with the fewest visits until the tree is down to three quarters of the memory budget,
+		 * and frees their states right away. The root and its children are kept, so every action of the root keeps
+		 * its statistics. The transposition table is rebuilt from the nodes that are left. The tree must be held
+		 * exclusively.
+		 */
+		void pruneTree();
+		// Prunes the tree if it has reached the memory budget and something is left to prune, taking it exclusively
+		void pruneToMemoryBudget();
+
+		// Adopts the posted root, if there is one that has not been adopted yet
+		void adoptPostedRoot();
+		/*
+		 * Makes the root, or the child or grandchild, with the most visits whose state matches the new root state
+		 * the root, keeping its statistics and its own state. Otherwise the whole tree is replaced. The tree must be
+		 * held exclusively.
+		 */
+		void reuseOrReplaceRoot(std::shared_ptr<State> rootState);
+		// Makes the node of the tree the root, releasing the rest of it. The tree must be held exclusively.
+		void moveRoot(Node &node);
+		// Replaces the whole tree with a new root, the tree must be held exclusively
+		void replaceRoot(std::shared_ptr<State> rootState);
+		// Takes the action from the root, the tree must be held exclusively
+		void performRootAction(Action action);
+
+		// Holds the tree exclusively for a request, and records how long the request took
+		class RequestGuard {
+			Mcts &_mcts;
+			Request _request;
+			std::chrono::steady_clock::time_point _start;
+
+		public:
+			RequestGuard(Mcts &mcts, const Request request) : _mcts(mcts), _request(request),
+			                                                  _start(std::chrono::steady_clock::now()) {
+				++_mcts._pendingRequests;
+				_mcts._mctsMutex.lock();
+			}
+
+			RequestGuard(const RequestGuard &) = delete;
+			RequestGuard &operator=(const RequestGuard &) = delete;
+
+			~RequestGuard() {
+				const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - _start;
+				_mcts._latencies[static_cast<std::size_t>(_request)].record(elapsed.count());
+				{
+					std::lock_guard lock(_mcts._requestMutex);
+					--_mcts._pendingRequests;
+				}
+				_mcts._mctsMutex.unlock();
+				_mcts._requestsHandled.notify_all();
+			}
+		};
 
-		std::vector<double> _actionWeights = std::vector<double>(10);
-		std::discrete_distribution<int> _weightedDist = std::discrete_distribution<int>();
+		// Sleeps until no requests are pending
+		void waitForRequests();
 
 		// Upper confidence bound applied to trees
-		[[nodiscard]] double uct(const std::shared_ptr<Node> &node) const;
-		[[nodiscard]] static double ucb1Normal2(const std::shared_ptr<Node> &node);
-		[[nodiscard]] static double ucb1Normal(const std::shared_ptr<Node> &node);
-		[[nodiscard]] double epsilonGreedy(const std::shared_ptr<Node> &node);
-		[[nodiscard]] double value(const std::shared_ptr<Node> &node);
-
-		std::vector<std::shared_ptr<Node> > getMaxNodes(
-			std::map<Action, std::shared_ptr<Node> > &children);
-		void singleSearch();
-		void threadedSearch();
-		void threadedSearchRollout(int numberOfRollouts);
+		[[nodiscard]] double uct(const Node *node) const;
+		[[nodiscard]] static double ucb1Normal2(const Node *node);
+		[[nodiscard]] static double ucb1Normal(const Node *node);
+		[[nodiscard]] double epsilonGreedy(SearchContext &context, const Node *node) const;
+		[[nodiscard]] double value(SearchContext &context, const Node *node) const;
+
+		// The child actions with the highest value, ties included, of the actions in the mask. Children that have not
+		// been built are unvisited.
+		StaticVector<Action, ACTION_COUNT> getMaxActions(SearchContext &context, const Node &node,
+		                                                 std::uint16_t actions = ALL_ACTIONS) const;
+
+		template<typename Container>
+		static auto randomChoice(SearchContext &context, const Container &container) -> decltype(*std::begin(container));
+		static Action weightedChoice(SearchContext &context, const std::vector<Action> &actions);
+		Node *selectNode(SearchContext &context);
+		/*
+		 * Selects a node of an open loop tree, simulating the selected actions on a copy of the root state with
+		 * random streams of its own, which the rollout then continues from. Only the actions that are legal in the
+		 * simulated state are selected from, and the node records every action that has been legal in it.
+		 */
+		Node *selectOpenLoop(SearchContext &context);
+		double rollout(SearchContext &context, Node *node) const;
+		double rollout(SearchContext &context, State state) const;
+		// Runs the rollouts per leaf from the state, sharing them with the rollout workers
+		Outcomes rollouts(SearchContext &context, const State &state);
+		// Backpropagates along the path the context selected in an open loop tree, with the probabilities of the
+		// states it simulated rather than of states kept in the nodes
+		void backPropagatePath(const SearchContext &context, Node *node, Outcomes outcomes) const;
+
+		void singleSearch(SearchContext &context);
+		void threadedSearch(SearchContext &context);
+		void threadedSearchRollout(SearchContext &context, unsigned int numberOfRollouts);
+		// Gives each of the threads a context with its own random stream, and virtual loss if they share the tree
+		void startSearchThreads(int threads, const std::function<void(SearchContext &)> &search);
 
 	public:
 		const ArmyValueFunction _armyValueFunction = ArmyValueFunction::MinPower;
 		const int END_PROBABILITY_FUNCTION = 0;
-		[[nodiscard]] std::shared_ptr<Node> getRootNode() {
-			_mctsMutex.lock();
-			auto node = _rootNode;
-			_mctsMutex.unlock();
-			return node;
+		// The node stays owned by the search tree, and is reused once it is no longer part of it
+		[[nodiscard]] Node *getRootNode() {
+			RequestGuard guard(*this, Request::getRootNode);
+			return _rootNode;
 		}
-
-		[[nodiscard]] std::shared_ptr<State> getRootState() {
-			_mctsMutex.lock();
-			auto state = _rootNode->getState();
-			_mctsMutex.unlock();
-			return state;
+		// A copy of the root detached from the tree, which can be kept after the root has moved on
+		[[nodiscard]] Node getRootNodeCopy() {
+			RequestGuard guard(*this, Request::getRootNode);
+			return _rootNode->detachedCopy();
 		}
 
+		// A copy of the root state from the latest snapshot, it does not wait for the search
+		[[nodiscard]] std::shared_ptr<State> getRootState() const { return _snapshot.load()->rootState; }
+
+		[[nodiscard]] std::shared_ptr<const SearchSnapshot> getSnapshot() const { return _snapshot.load(); }
+
 		void setEndTime(const int time) {
-			_mctsMutex.lock();
+			RequestGuard guard(*this, Request::setEndTime);
 			_rolloutEndTime = time;
-			_mctsMutex.unlock();
 		}
 
-		std::shared_ptr<Node> randomChoice(const std::map<Action, std::shared_ptr<Node> > &nodes);
+		// Sets how many searches a search thread runs each time it takes the lock, it lets go earlier for requests
+		void setSearchBatch(const int searches) {
+			if (searches < 1) {
+				throw std::invalid_argument("A search batch needs at least one search.");
+			}
+			RequestGuard guard(*this, Request::setSearchBatch);
+			_searchBatch = searches;
+		}
 
-		template<typename Container>
-		auto randomChoice(const Container &container) -> decltype(*std::begin(container));
+		// Sets how far a new root state can be from the state of a node for the node to be reused as the root
+		void setReuseTolerance(const StateTolerance &tolerance) {
+			RequestGuard guard(*this, Request::setReuseTolerance);
+			_reuseTolerance = tolerance;
+		}
 
-		std::shared_ptr<Node> selectNode();
+		/*
+		 * Whether the tree is searched open loop. Its nodes below the root keep only the statistics of their actions,
+		 * and every search simulates the selected actions anew from the root state with a fresh sample of the enemy.
+		 * Switching replaces the tree with a new one from the root state.
+		 */
+		void setOpenLoop(bool openLoop);
+		[[nodiscard]] bool isOpenLoop() const { return _nodes.isOpenLoop(); }
+
+		// Whether new nodes share their statistics with the nodes that have the same state, which they do by default
+		void setTranspositions(const bool enabled) {
+			RequestGuard guard(*this, Request::setTranspositions);
+			_nodes.setTranspositionTable(enabled ? &_transpositions : nullptr);
+			_nodes.rebuildTranspositions(*_rootNode);
+			if (!enabled) {
+				_transpositions.clear();
+			}
+		}
+
+		// The number of distinct states of the nodes in the tree
+		[[nodiscard]] std::size_t getTranspositionCount() { return _transpositions.size(); }
+
+		/*
+		 * Caps the memory the tree takes, in bytes, or lifts the cap with 0. Once the tree reaches it the search stops
+		 * building nodes, rolling out from where it stopped instead, and prunes the least visited subtrees between
+		 * batches of searches so that the tree can grow where the search is spending its visits.
+		 * The budget covers the nodes in use, their states and transposition entries. The chunks the pool allocates
+		 * nodes in are kept once pruned nodes are freed, so they stay at the largest the tree has been.
+		 */
+		void setMemoryBudget(std::size_t bytes);
+
+		// The memory the tree takes, it does not wait for the search
+		[[nodiscard]] TreeMemory getTreeMemory() const {
+			return {
+				_nodes.size(), _nodes.stateCount(), _transpositions.size(), memoryUsage(), _memoryBudget,
+				_nodes.reservedBytes(), _prunedNodes
+			};
+		}
 
-		static void expand(const std::shared_ptr<Node> &node, const std::shared_ptr<State> &state);
+		[[nodiscard]] TreeReuse getTreeReuse() {
+			RequestGuard guard(*this, Request::getTreeReuse);
+			return _treeReuse;
+		}
+
+		// The latency of each type of request that has been made, including the time spent waiting for the search
+		[[nodiscard]] std::vector<RequestLatency> getRequestLatencies() {
+			RequestGuard guard(*this, Request::getRequestLatencies);
+			std::vector<RequestLatency> latencies;
+			for (std::size_t i = 0; i < REQUEST_TYPES; i++) {
+				if (const auto &recorder = _latencies[i]; recorder.count() > 0) {
+					latencies.push_back({
+						requestToString(static_cast<Request>(i)), recorder.count(), recorder.percentile(0.5),
+						recorder.percentile(0.99)
+					});
+				}
+			}
+			return latencies;
+		}
+
+		Node *selectNode() { return selectNode(_context); }
 
-		Action weightedChoice(const std::vector<Action> &actions);
 		static double calculateTotalWinProbability(const std::vector<double> &winProbabilities, const std::vector<double> &continueProbabilities);
-		double rollout(const std::shared_ptr<Node> &node);
+		double rollout(Node *node) { return rollout(_context, node); }
+
+		// Adds the outcome to the node and its ancestors, and takes back the virtual loss selection added to them
+		static void backPropagate(Node *node, double outcome, int virtualLoss = 0);
+		// Adds a batch of outcomes from the same node at once
+		static void backPropagate(Node *node, Outcomes outcomes, int virtualLoss = 0);
 
-		static void backPropagate(std::shared_ptr<Node> node, double outcome);
+		// Runs a batch of rollouts from every selected node instead of a single one, on a pool of worker threads
+		// as well as the searching thread. No workers runs the whole batch on the searching thread.
+		void setLeafParallelism(int rolloutsPerLeaf, int workers);
 
-		void startSearchRolloutThread(int numberOfRollouts);
+		// Searches until the tree has seen the number of rollouts, with the threads sharing the tree
+		void startSearchRolloutThread(int numberOfRollouts, int threads = 1);
 		void search(int timeLimit);
 		void searchRollout(int rollouts);
 		void stopSearchThread();
-		void startSearchThread();
+		// Searches until stopped, with the threads sharing the tree
+		void startSearchThread(int threads = 1);
 
 		void performAction(Action action);
 
+		// The best action according to the latest snapshot, it does not wait for the search
 		Action getBestAction();
+
+		// The statistics of every action the root was expanded with in the latest snapshot, unbuilt children
+		// having no visits
+		[[nodiscard]] StaticVector<ActionStatistics, ACTION_COUNT> getRootStatistics() const {
+			return _snapshot.load()->actions;
+		}
+
 		void updateRootState(const std::shared_ptr<State> &state);
 
+		/*
+		 * Posts a new root state, and the actions to take from it, for the search threads to adopt between batches
+		 * of searches, without waiting for them. A root posted before the last one was adopted replaces it. Without
+		 * search threads it is adopted right away. Returns the sequence number of the root.
+		 */
+		std::uint64_t postRootState(const std::shared_ptr<State> &state, const std::vector<Action> &actions = {});
+		// The sequence number of the latest posted root that has been adopted
+		[[nodiscard]] std::uint64_t getAdoptedRoot() const { return _adoptedRoots; }
+		// Waits until the root with the sequence number, or a later one, has been adopted
+		void waitForRoot(std::uint64_t sequence);
+
 		void updateRootState(const StateBuilderParams &params) {
-			std::uniform_int_distribution<unsigned int> dist;
-			const auto state = State::InternalStateBuilder(params, 1 , Sc2::ArmyValueFunction::MinPower, dist(_rng) );
+			const auto state = State::InternalStateBuilder(params, 1 , Sc2::ArmyValueFunction::MinPower, static_cast<unsigned int>(_context.rng()));
 
 			updateRootState(state);
 		}
 
-		[[nodiscard]] unsigned int getNumberOfRollouts() {
-			_mctsRequestsPending = true;
-			_mctsMutex.lock();
-			const auto n = _numberOfRollouts;
-			_mctsMutex.unlock();
-			_mctsRequestsPending = false;
-			return n;
-		}
+		[[nodiscard]] unsigned int getNumberOfRollouts() const { return _numberOfRollouts; }
 
 		[[nodiscard]] std::string toString() const {
 			std::string rolloutHeuristicStr;
@@ -161,25 +461,39 @@ namespace Sc2::Mcts {
 																 _armyValueFunction(armyValueFunction),
 																 END_PROBABILITY_FUNCTION(endProbabilityFunction)
 		{
-			_rng = std::mt19937(seed);
+			_context.rng = Rng(seed);
 			const auto deepCopy = State::DeepCopy(*rootState);
 			deepCopy->setEndProbabilityFunction(endProbabilityFunction);
 			deepCopy->setArmyValueFunction(armyValueFunction);
-			_rootNode = std::make_shared<Node>(Node(Action::none, nullptr, deepCopy));
+			_rootNode = _nodes.create(Action::none, nullptr, deepCopy);
+			publishSnapshot();
 		}
 
 		explicit Mcts(const std::shared_ptr<State> &rootState) {
 			const auto seed = std::random_device{}();
-			_rng = std::mt19937(seed);
+			_context.rng = Rng(seed);
 			const auto deepCopy = State::DeepCopy(*rootState);
-			_rootNode = std::make_shared<Node>(Node(Action::none, nullptr, deepCopy));
+			_rootNode = _nodes.create(Action::none, nullptr, deepCopy);
+			publishSnapshot();
 		}
 
 		Mcts() {
 			const auto seed = std::random_device{}();
-			_rng = std::mt19937(seed);
+			_context.rng = Rng(seed);
 			auto rootState = std::make_shared<State>(_rolloutEndTime, 0, ArmyValueFunction::MinPower, seed);
-			_rootNode = std::make_shared<Node>(Action::none, nullptr, rootState);
+			_rootNode = _nodes.create(Action::none, nullptr, rootState);
+			publishSnapshot();
+		}
+
+		~Mcts() {
+			{
+				std::lock_guard lock(_reclaimMutex);
+				_stopReclaiming = true;
+			}
+			_reclaimNeeded.notify_one();
+			if (_reclaimer.joinable()) {
+				_reclaimer.join();
+			}
 		}
 	};
 
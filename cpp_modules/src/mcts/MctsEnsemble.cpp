@@ -0,0 +1,201 @@
+#include <array>
+#include <bit>
+#include <cmath>
+#include <thread>
+
+#include "MctsEnsemble.h"
+
+using namespace Sc2::Mcts;
+
+
+MctsEnsemble::MctsEnsemble(const std::shared_ptr<State> &rootState, const unsigned int seed,
+                           const int rolloutEndTime, const double exploration, const ValueHeuristic valueHeuristic,
+                           const RolloutHeuristic rolloutHeuristic, const int endProbabilityFunction,
+                           const ArmyValueFunction armyValueFunction, const int trees) : _rng(seed) {
+	if (trees < 1) {
+		throw std::invalid_argument("An ensemble needs at least one tree.");
+	}
+	for (const auto &state: splitStates(*rootState, trees)) {
+		_trees.push_back(std::make_unique<Mcts>(state, static_cast<unsigned int>(_rng()), rolloutEndTime,
+		                                        exploration, valueHeuristic, rolloutHeuristic,
+		                                        endProbabilityFunction, armyValueFunction));
+	}
+}
+
+template<typename Function>
+void MctsEnsemble::forEachTree(const Function &function) {
+	std::vector<std::thread> threads;
+	for (const auto &tree: _trees) {
+		threads.emplace_back([&function, &tree] { function(*tree); });
+	}
+	for (auto &thread: threads) {
+		thread.join();
+	}
+}
+
+std::vector<std::shared_ptr<Sc2::State> > MctsEnsemble::splitStates(const Sc2::State &state, const std::size_t count) {
+	const auto source = Sc2::State::DeepCopy(state);
+	std::vector<std::shared_ptr<Sc2::State> > states;
+	for (std::size_t i = 0; i < count; i++) {
+		auto copy = Sc2::State::DeepCopy(*source);
+		copy->splitRandomStreams(*source);
+		states.push_back(std::move(copy));
+	}
+	return states;
+}
+
+void MctsEnsemble::setEndTime(const int time) {
+	for (const auto &tree: _trees) {
+		tree->setEndTime(time);
+	}
+}
+
+void MctsEnsemble::searchRollout(const int rollouts) {
+	const auto count = static_cast<int>(_trees.size());
+	forEachTree([rollouts, count](Mcts &tree) { tree.searchRollout((rollouts + count - 1) / count); });
+}
+
+void MctsEnsemble::startSearchRolloutThread(const int numberOfRollouts) {
+	const auto count = static_cast<int>(_trees.size());
+	for (const auto &tree: _trees) {
+		tree->startSearchRolloutThread((numberOfRollouts + count - 1) / count);
+	}
+}
+
+void MctsEnsemble::startSearchThread() {
+	for (const auto &tree: _trees) {
+		tree->startSearchThread();
+	}
+}
+
+void MctsEnsemble::stopSearchThread() {
+	for (const auto &tree: _trees) {
+		tree->stopSearchThread();
+	}
+}
+
+Action MctsEnsemble::getBestAction() {
+	std::array<int, ACTION_COUNT> visits{};
+	std::array<double, ACTION_COUNT> totalValues{};
+	std::uint16_t actionMask = 0;
+
+	for (const auto &tree: _trees) {
+		for (const auto &[action, actionVisits, totalValue]: tree->getRootStatistics()) {
+			const auto index = static_cast<std::size_t>(action);
+			visits[index] += actionVisits;
+			totalValues[index] += totalValue;
+			actionMask |= actionBit(action);
+		}
+	}
+
+	auto maxValue = -INFINITY;
+	StaticVector<Action, ACTION_COUNT> maxActions = {};
+	for (auto mask = actionMask; mask != 0; mask &= mask - 1) {
+		const auto index = std::countr_zero(mask);
+		// only give an action if every tree taken together has explored all of them once
+		if (visits[index] < 1) {
+			return Action::none;
+		}
+
+		const auto value = totalValues[index] / visits[index];
+		if (value > maxValue) {
+			maxActions.clear();
+			maxActions.push_back(static_cast<Action>(index));
+			maxValue = value;
+		} else if (value == maxValue) {
+			maxActions.push_back(static_cast<Action>(index));
+		}
+	}
+
+	if (maxActions.empty()) {
+		return Action::none;
+	}
+	return maxActions[_rng.below(static_cast<std::uint32_t>(maxActions.size()))];
+}
+
+void MctsEnsemble::performAction(const Action action) {
+	for (const auto &tree: _trees) {
+		tree->performAction(action);
+	}
+}
+
+void MctsEnsemble::updateRootState(const std::shared_ptr<State> &state) {
+	const auto states = splitStates(*state, _trees.size());
+	for (std::size_t i = 0; i < _trees.size(); i++) {
+		_trees[i]->updateRootState(states[i]);
+	}
+}
+
+std::uint64_t MctsEnsemble::postRootState(const std::shared_ptr<State> &state, const std::vector<Action> &actions) {
+	const auto states = splitStates(*state, _trees.size());
+	std::uint64_t sequence = 0;
+	for (std::size_t i = 0; i < _trees.size(); i++) {
+		sequence = _trees[i]->postRootState(states[i], actions);
+	}
+	return sequence;
+}
+
+void MctsEnsemble::waitForRoot(const std::uint64_t sequence) {
+	for (const auto &tree: _trees) {
+		tree->waitForRoot(sequence);
+	}
+}
+
+void MctsEnsemble::updateRootState(const StateBuilderParams &params) {
+	// Each tree seeds the state it builds from its own generator
+	for (const auto &tree: _trees) {
+		tree->updateRootState(params);
+	}
+}
+
+void MctsEnsemble::setReuseTolerance(const StateTolerance &tolerance) {
+	for (const auto &tree: _trees) {
+		tree->setReuseTolerance(tolerance);
+	}
+}
+
+void MctsEnsemble::setOpenLoop(const bool openLoop) {
+	for (const auto &tree: _trees) {
+		tree->setOpenLoop(openLoop);
+	}
+}
+
+void MctsEnsemble::setMemoryBudget(const std::size_t bytes) {
+	for (const auto &tree: _trees) {
+		tree->setMemoryBudget(bytes / _trees.size());
+	}
+}
+
+Mcts::TreeMemory MctsEnsemble::getTreeMemory() const {
+	Mcts::TreeMemory memory;
+	for (const auto &tree: _trees) {
+		const auto treeMemory = tree->getTreeMemory();
+		memory.nodes += treeMemory.nodes;
+		memory.states += treeMemory.states;
+		memory.transpositions += treeMemory.transpositions;
+		memory.bytes += treeMemory.bytes;
+		memory.budget += treeMemory.budget;
+		memory.reservedBytes += treeMemory.reservedBytes;
+		memory.prunedNodes += treeMemory.prunedNodes;
+	}
+	return memory;
+}
+
+Mcts::TreeReuse MctsEnsemble::getTreeReuse() {
+	Mcts::TreeReuse reuse;
+	for (const auto &tree: _trees) {
+		const auto treeReuse = tree->getTreeReuse();
+		reuse.attempts += treeReuse.attempts;
+		reuse.hits += treeReuse.hits;
+		reuse.reusedVisits += treeReuse.reusedVisits;
+	}
+	return reuse;
+}
+
+unsigned int MctsEnsemble::getNumberOfRollouts() {
+	unsigned int rollouts = 0;
+	for (const auto &tree: _trees) {
+		rollouts += tree->getNumberOfRollouts();
+	}
+	return rollouts;
+}
@@ -0,0 +1,82 @@
+#ifndef MCTSENSEMBLE_H
+#define MCTSENSEMBLE_H
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "Mcts.h"
+
+
+namespace Sc2::Mcts {
+	/*
+	 * Root parallel search. Each of the trees searches on a thread of its own with its own seed, and its root state
+	 * has random streams of its own, so the trees sample different enemies. They share nothing while searching, and
+	 * the statistics of the root's actions are only merged when the best action is asked for.
+	 */
+	class MctsEnsemble {
+		Rng _rng;
+		std::vector<std::unique_ptr<Mcts> > _trees;
+
+		// Calls the function on every tree at once, each on a thread of its own
+		template<typename Function>
+		void forEachTree(const Function &function);
+
+		// Copies of the state, as many as there are trees, that each have random streams of their own
+		static std::vector<std::shared_ptr<State> > splitStates(const State &state, std::size_t count);
+
+	public:
+		explicit MctsEnsemble(const std::shared_ptr<State> &rootState, unsigned int seed, int rolloutEndTime,
+		                      double exploration, ValueHeuristic valueHeuristic, RolloutHeuristic rolloutHeuristic,
+		                      int endProbabilityFunction, ArmyValueFunction armyValueFunction, int trees);
+
+		[[nodiscard]] int getTreeCount() const { return static_cast<int>(_trees.size()); }
+		[[nodiscard]] Mcts &getTree(const int index) { return *_trees.at(index); }
+
+		[[nodiscard]] std::shared_ptr<State> getRootState() { return _trees.front()->getRootState(); }
+
+		void setEndTime(int time);
+
+		// Searches until the trees have seen the number of rollouts between them
+		void searchRollout(int rollouts);
+		void startSearchRolloutThread(int numberOfRollouts);
+		void startSearchThread();
+		void stopSearchThread();
+
+		// The action with the highest mean outcome over the visits of every tree
+		Action getBestAction();
+		void performAction(Action action);
+		void updateRootState(const std::shared_ptr<State> &state);
+		void updateRootState(const StateBuilderParams &params);
+		// Posts the root state to every tree, each adopting it without the caller waiting for them. Every post goes
+		// to all of the trees, so they number their posts alike. Returns the sequence number of the root.
+		std::uint64_t postRootState(const std::shared_ptr<State> &state, const std::vector<Action> &actions = {});
+		// Waits until every tree has adopted the root with the sequence number, or a later one
+		void waitForRoot(std::uint64_t sequence);
+
+		void setReuseTolerance(const StateTolerance &tolerance);
+		void setOpenLoop(bool openLoop);
+		// Caps the memory of the trees together, each tree getting an even share of the budget
+		void setMemoryBudget(std::size_t bytes);
+		// The memory of every tree, summed
+		[[nodiscard]] Mcts::TreeMemory getTreeMemory() const;
+		// The reuse of every tree, summed
+		[[nodiscard]] Mcts::TreeReuse getTreeReuse();
+
+		[[nodiscard]] unsigned int getNumberOfRollouts();
+
+		[[nodiscard]] std::string toString() const {
+			std::ostringstream str;
+			str << "MCTS ensemble of " << _trees.size() << " trees: { \n"
+			<< _trees.front()->toString()
+			<< "} \n";
+			return str.str();
+		}
+	};
+
+	inline std::ostream &operator<<(std::ostream &os, const MctsEnsemble &ensemble) {
+		os << ensemble.toString();
+		return os;
+	}
+}
+
+#endif //MCTSENSEMBLE_H
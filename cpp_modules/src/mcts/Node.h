@@ -4,23 +4,96 @@
 
 #ifndef NODE_H
 #define NODE_H
-#include <map>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
 #include <utility>
 #include <vector>
 #include <sstream>
 
 #include "ActionEnum.h"
+#include "TranspositionTable.h"
 
 namespace Sc2::Mcts {
-	class Node : public std::enable_shared_from_this<Node> {
-		Action _action;
+	using NodeIndex = std::uint32_t;
+	constexpr NodeIndex NO_NODE = std::numeric_limits<NodeIndex>::max();
+
+	class NodePool;
+
+	constexpr std::uint16_t actionBit(const Action action) {
+		return static_cast<std::uint16_t>(1u << static_cast<unsigned>(action));
+	}
+	// A mask with the bit of every action set
+	constexpr std::uint16_t ALL_ACTIONS = static_cast<std::uint16_t>((1u << ACTION_COUNT) - 1);
+
+	// The outcomes of several rollouts, summarised by their count, mean and sum of squared differences from the mean
+	struct Outcomes {
+		int count = 0;
+		double mean = 0;
+		double M2 = 0;
+
+		// Adds an outcome using Welfords online algorithm
+		void add(const double outcome) {
+			count++;
+			const auto delta = outcome - mean;
+			mean += delta / count;
+			M2 += delta * (outcome - mean);
+		}
+
+		// The outcomes after mapping each of them to offset + scale * outcome
+		[[nodiscard]] Outcomes transformed(const double offset, const double scale) const {
+			return {count, offset + scale * mean, scale * scale * M2};
+		}
+	};
+
+	/*
+	 * A node of the search tree. Several threads can search the same tree, so the statistics are read and written
+	 * through std::atomic_ref and the masks of expanded actions and built children are published with release stores.
+	 * The node itself is a spinlock, held while updating the statistics and while building a child.
+	 */
+	class Node {
+		// Spins on a held lock before yielding to the scheduler, it is only held for a few updates at a time
+		static constexpr int SPINS_BEFORE_YIELD = 64;
+
+		Action _action = Action::none;
 		int depth = 0;
 
-		std::weak_ptr<Node> _parent;
+		NodePool *_pool = nullptr;
+		NodeIndex _index = NO_NODE;
+		NodeIndex _parent = NO_NODE;
+		// The actions the node was expanded with. Their children are only built once selection first reaches them.
+		std::uint16_t _actionMask = 0;
+		// The children indexed by their action, only the entries whose bit is set in _childMask are valid
+		std::array<NodeIndex, ACTION_COUNT> _children{};
+		std::uint16_t _childMask = 0;
+		std::uint32_t _lock = 0;
+		// Visits of searches that are still on their way through the node, counted as losses until they finish
+		int _virtualLoss = 0;
+		// The statistics shared with the other nodes that have the same state, if the pool keeps any
+		TranspositionEntry *_transposition = nullptr;
 
 		std::shared_ptr<State> _state;
 
+		friend class NodePool;
+
+		template<typename T>
+		static T load(const T &value, const std::memory_order order = std::memory_order_relaxed) {
+			return std::atomic_ref(const_cast<T &>(value)).load(order);
+		}
+
+		template<typename T>
+		static void store(T &value, const T desired, const std::memory_order order = std::memory_order_relaxed) {
+			std::atomic_ref(value).store(desired, order);
+		}
+
 	public:
 		// Number of simulations that has been run on this node
 		int N = 0;
@@ -33,14 +106,181 @@ namespace Sc2::Mcts {
 		std::tuple<double, double, double> winProbabilities;
 
 		double getSampleVariance() const {
-			return M2 / N - 1;
+			return load(M2) / load(N) - 1;
+		}
+
+		void lock() {
+			std::atomic_ref lock(_lock);
+			while (lock.exchange(1, std::memory_order_acquire) != 0) {
+				for (int spins = 0; lock.load(std::memory_order_relaxed) != 0; spins++) {
+					if (spins >= SPINS_BEFORE_YIELD) {
+						std::this_thread::yield();
+					}
+				}
+			}
+		}
+
+		void unlock() { std::atomic_ref(_lock).store(0, std::memory_order_release); }
+
+		[[nodiscard]] int getVisits() const { return load(N); }
+		// The number of simulations, including the ones still in progress that count as virtual losses
+		[[nodiscard]] int getEffectiveVisits() const { return load(N) + load(_virtualLoss); }
+		[[nodiscard]] double getTotalValue() const { return load(Q); }
+		/*
+		 * The mean value, over the visits of every node with the same state if there is a transposition entry.
+		 * Simulations still in progress through this node count as losses. The node must have effective visits.
+		 */
+		[[nodiscard]] double getMeanValue() const {
+			if (_transposition == nullptr) {
+				return load(Q) / getEffectiveVisits();
+			}
+			return _transposition->getTotalValue() / (_transposition->getVisits() + load(_virtualLoss));
+		}
+		void addVirtualLoss(const int virtualLoss) {
+			if (virtualLoss != 0) {
+				std::atomic_ref(_virtualLoss).fetch_add(virtualLoss, std::memory_order_relaxed);
+			}
+		}
+
+		// Adds the outcome of a simulation, and removes the virtual loss it added on its way down
+		void update(const double outcome, const int virtualLoss = 0) {
+			std::lock_guard guard(*this);
+			const auto oldMean = N == 0 ? 0 : Q / N;
+
+			store(N, N + 1);
+			store(Q, Q + outcome);
+
+			const auto newMean = Q / N;
+			const auto delta = outcome - oldMean;
+			// M2 is updated using Welfords online algorithm
+			store(M2, M2 + delta * (outcome - newMean));
+			if (_transposition != nullptr) {
+				_transposition->add(1, outcome);
+			}
+			if (virtualLoss != 0) {
+				// Selection adds virtual loss without taking the lock
+				std::atomic_ref(_virtualLoss).fetch_sub(virtualLoss, std::memory_order_relaxed);
+			}
 		}
 
-		std::map<Action, std::shared_ptr<Node> > children = {};
+		// Adds the outcomes of a batch of simulations at once, and removes the virtual loss they added on their way down
+		void update(const Outcomes &outcomes, const int virtualLoss = 0) {
+			if (outcomes.count == 0) {
+				return;
+			}
+			std::lock_guard guard(*this);
+			const auto mean = N == 0 ? 0 : Q / N;
+			const auto count = N + outcomes.count;
+			const auto delta = outcomes.mean - mean;
+
+			// The batch is merged with the pairwise update of Chan et al., which reduces to Welfords for one outcome
+			store(M2, M2 + outcomes.M2 + delta * delta * N * outcomes.count / count);
+			store(Q, Q + outcomes.mean * outcomes.count);
+			store(N, count);
+			if (_transposition != nullptr) {
+				_transposition->add(outcomes.count, outcomes.mean * outcomes.count);
+			}
+			if (virtualLoss != 0) {
+				std::atomic_ref(_virtualLoss).fetch_sub(virtualLoss, std::memory_order_relaxed);
+			}
+		}
+
+		// A forward range over the children of a node, in the order of their actions
+		class Children {
+			const NodePool *_pool;
+			const std::array<NodeIndex, ACTION_COUNT> *_children;
+			std::uint16_t _mask;
+
+		public:
+			class iterator {
+				const NodePool *_pool = nullptr;
+				const std::array<NodeIndex, ACTION_COUNT> *_children = nullptr;
+				std::uint16_t _mask = 0;
+
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = Node *;
+				using difference_type = std::ptrdiff_t;
+				using pointer = Node **;
+				using reference = Node *;
+
+				iterator() = default;
+				iterator(const NodePool *pool, const std::array<NodeIndex, ACTION_COUNT> *children,
+				         const std::uint16_t mask): _pool(pool), _children(children), _mask(mask) {}
+
+				Node *operator*() const;
+				iterator &operator++() {
+					_mask &= _mask - 1;
+					return *this;
+				}
+				iterator operator++(int) {
+					auto previous = *this;
+					++*this;
+					return previous;
+				}
+				bool operator==(const iterator &other) const { return _mask == other._mask; }
+			};
+
+			Children(const NodePool *pool, const std::array<NodeIndex, ACTION_COUNT> *children,
+			         const std::uint16_t mask): _pool(pool), _children(children), _mask(mask) {}
+
+			[[nodiscard]] iterator begin() const { return {_pool, _children, _mask}; }
+			[[nodiscard]] iterator end() const { return {_pool, _children, 0}; }
+			[[nodiscard]] std::size_t size() const { return std::popcount(_mask); }
+			[[nodiscard]] bool empty() const { return _mask == 0; }
+		};
 
+		// The children that have been built
+		[[nodiscard]] Children getChildren() const {
+			return {_pool, &_children, load(_childMask, std::memory_order_acquire)};
+		}
+		// A bit per action, set for the actions that have a child that has been built
+		[[nodiscard]] std::uint16_t getChildMask() const { return load(_childMask, std::memory_order_acquire); }
+		// A bit per action, set for the actions the node was expanded with
+		[[nodiscard]] std::uint16_t getActionMask() const { return load(_actionMask, std::memory_order_acquire); }
+		[[nodiscard]] bool isExpanded() const { return getActionMask() != 0; }
+		// The actions the node was expanded with, in order
+		[[nodiscard]] StaticVector<Action, ACTION_COUNT> getChildActions() const {
+			StaticVector<Action, ACTION_COUNT> actions;
+			for (auto mask = getActionMask(); mask != 0; mask &= mask - 1) {
+				actions.push_back(static_cast<Action>(std::countr_zero(mask)));
+			}
+			return actions;
+		}
+		// The child reached by the action, or nullptr if it has not been built
+		[[nodiscard]] Node *getChild(Action action) const;
+		// The child reached by the action, which is built first if the node was expanded with the action but the
+		// child has not been built yet. nullptr if the node was not expanded with the action.
+		Node *getOrAddChild(Action action);
+
+		// The state of the node, nullptr below the root of an open loop tree
 		std::shared_ptr<State> getState() { return _state; }
-		void setParent(const std::shared_ptr<Node> &parent) { _parent = parent; }
-		std::shared_ptr<Node> getParent() const { return _parent.lock(); }
+		/*
+		 * A copy of the node on its own, with a copy of its state, that stays valid once the node is released and
+		 * reclaimed. It keeps its statistics and the actions it was expanded with, but has no parent or children.
+		 */
+		[[nodiscard]] Node detachedCopy() {
+			std::lock_guard guard(*this);
+			auto copy = *this;
+			copy._pool = nullptr;
+			copy._index = NO_NODE;
+			copy._parent = NO_NODE;
+			copy._childMask = 0;
+			copy._lock = 0;
+			copy._virtualLoss = 0;
+			copy._transposition = nullptr;
+			if (_state != nullptr) {
+				copy._state = std::make_shared<State>(*_state);
+			}
+			return copy;
+		}
+		// A copy of the state, taken while building children cannot split off its random streams
+		State copyState() {
+			std::lock_guard guard(*this);
+			return *_state;
+		}
+		[[nodiscard]] Node *getParent() const;
+		[[nodiscard]] NodeIndex getIndex() const { return _index; }
 		[[nodiscard]] Action getAction() const { return _action; }
 		int getDepth() const { return depth; }
 
@@ -52,21 +292,20 @@ namespace Sc2::Mcts {
 			addChildren(actions);
 		}
 
+		// Records the actions as children of the node, without building their states yet
 		void addChildren(const std::vector<Action> &childActions) {
-			for (const auto &childAction: childActions) {
-				const auto state = State::DeepCopy(*_state);
-
-				const auto childNode = std::make_shared<Node>(Node(childAction, shared_from_this(), state));
-				childNode->depth = this->depth + 1;
-				children[childNode->_action] = childNode;
+			std::uint16_t mask = 0;
+			for (const auto action: childActions) {
+				mask |= actionBit(action);
 			}
+			std::atomic_ref(_actionMask).fetch_or(mask, std::memory_order_release);
 		}
 
 		[[nodiscard]] std::string toString() const {
 			std::ostringstream str;
 			str << "Node: " << static_cast<int>(_action) << "{ \n"
-			<< "parent: " << (_parent.lock() != nullptr) << "\n"
-			<< "children: " << children.size() << "\n"
+			<< "parent: " << (_parent != NO_NODE) << "\n"
+			<< "children: " << std::popcount(getActionMask()) << "\n"
 			<< "numberOfSimulations: " << N << "\n"
 			<< "Q: " << Q << "\n"
 			<< "} \n";
@@ -77,17 +316,288 @@ namespace Sc2::Mcts {
 			return _state->endTimeReached() || _state->getLegalActions()[0] == Action::none;
 		}
 
-		explicit Node(std::shared_ptr<State> state): _action(Action::none),
-		                                             _parent(), _state(std::move(state)) {
+		Node() = default;
+
+		Node(NodePool &pool, const NodeIndex index, const Action action, const Node *parent,
+		     std::shared_ptr<State> state) : _action(action), _pool(&pool), _index(index),
+		                                     _parent(parent == nullptr ? NO_NODE : parent->_index),
+		                                     _state(std::move(state)) {
+			if (_state != nullptr) {
+				_state->performAction(action);
+				winProbabilities = _state->getWinProbabilities();
+			}
 		}
+	};
 
-		Node(const Action action, const std::shared_ptr<Node> &parent, std::shared_ptr<State> state) : _action(action),
-			_parent(parent), _state(std::move(state)) {
-			_state->performAction(action);
-			winProbabilities = _state->getWinProbabilities();
+	/*
+	 * The arena the nodes of a search tree live in. Nodes are stored in chunks, so they never move,
+	 * and refer to each other by their index in the pool.
+	 * Releasing a subtree only records its root, its nodes are reclaimed one by one when new nodes need the space.
+	 */
+	class NodePool {
+		static constexpr NodeIndex CHUNK_BITS = 12;
+		static constexpr NodeIndex CHUNK_SIZE = NodeIndex{1} << CHUNK_BITS;
+		// The chunk table is reserved up front, so that it never moves while other threads read nodes from it
+		static constexpr std::size_t MAX_CHUNKS = std::size_t{1} << 14;
+
+		std::vector<std::unique_ptr<Node[]> > _chunks;
+		// Gives new nodes the entry of their state, if it is set
+		TranspositionTable *_transpositions = nullptr;
+		// Whether children are built without a state, which the search simulates anew on every visit instead
+		bool _openLoop = false;
+		// Guards the chunks and the released subtrees, the nodes themselves are built outside of it
+		std::mutex _mutex;
+		// Every index below _size has been handed out at some point
+		NodeIndex _size = 0;
+		// Roots of released subtrees, whose nodes can be reused
+		std::vector<NodeIndex> _released;
+		// Released nodes that have been reclaimed, their children released and their states dropped
+		std::vector<NodeIndex> _free;
+		// The nodes and states that take memory, which includes released nodes until they are reclaimed or reused
+		std::atomic<std::size_t> _nodeCount = 0;
+		std::atomic<std::size_t> _stateCount = 0;
+		// What the pool holds on to whether the nodes are in use or not, kept up to date under the lock
+		std::atomic<std::size_t> _chunkCount = 0;
+		std::atomic<std::size_t> _listBytes = 0;
+
+		// Records the memory of the lists of released and free nodes, which only grow. The lock must be held.
+		void updateListBytes() {
+			_listBytes = (_released.capacity() + _free.capacity()) * sizeof(NodeIndex);
+		}
+
+		// Counts the node and its state as gone, once it has been reclaimed or is about to be reused
+		void drop(const Node &node) {
+			--_nodeCount;
+			if (node._state != nullptr) {
+				--_stateCount;
+			}
+		}
+
+		NodeIndex allocate() {
+			std::lock_guard guard(_mutex);
+			if (!_free.empty()) {
+				const auto index = _free.back();
+				_free.pop_back();
+				return index;
+			}
+			// Without reclaimed nodes the released subtrees are taken apart here instead
+			if (!_released.empty()) {
+				const auto index = _released.back();
+				_released.pop_back();
+				const auto &node = get(index);
+				for (auto mask = node._childMask; mask != 0; mask &= mask - 1) {
+					_released.push_back(node._children[std::countr_zero(mask)]);
+				}
+				updateListBytes();
+				drop(node);
+				return index;
+			}
+			if (_size == _chunks.size() * CHUNK_SIZE) {
+				if (_chunks.size() == MAX_CHUNKS) {
+					throw std::length_error("The search tree has run out of nodes");
+				}
+				_chunks.push_back(std::make_unique<Node[]>(CHUNK_SIZE));
+				++_chunkCount;
+			}
+			return _size++;
+		}
+
+		void unlink(Node &child) {
+			if (child._parent == NO_NODE) {
+				return;
+			}
+			std::atomic_ref(get(child._parent)._childMask).fetch_and(
+				static_cast<std::uint16_t>(~actionBit(child._action)), std::memory_order_release);
+			child._parent = NO_NODE;
+		}
+
+	public:
+		explicit NodePool(TranspositionTable *transpositions = nullptr) : _transpositions(transpositions) {
+			_chunks.reserve(MAX_CHUNKS);
+		}
+		NodePool(const NodePool &) = delete;
+		NodePool &operator=(const NodePool &) = delete;
+
+		[[nodiscard]] Node &get(const NodeIndex index) const {
+			return _chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)];
+		}
+
+		// Creates a node by taking the action in the state, as a child of the parent unless it is nullptr
+		Node *create(const Action action, Node *parent, std::shared_ptr<State> state) {
+			const auto index = allocate();
+			auto &node = get(index);
+			node = Node(*this, index, action, parent, std::move(state));
+			++_nodeCount;
+			if (node._state != nullptr) {
+				++_stateCount;
+				if (_transpositions != nullptr) {
+					node._transposition = &_transpositions->find(node._state->hash());
+				}
+			}
+
+			if (parent != nullptr) {
+				node.depth = parent->depth + 1;
+				// A new child replaces one with the same action
+				if (const auto existing = parent->getChild(action); existing != nullptr) {
+					release(*existing);
+				}
+				parent->_children[static_cast<std::size_t>(action)] = index;
+				// Publishing the child in the masks makes it, and the node it was built into, visible to other threads
+				std::atomic_ref(parent->_actionMask).fetch_or(actionBit(action), std::memory_order_release);
+				std::atomic_ref(parent->_childMask).fetch_or(actionBit(action), std::memory_order_release);
+			}
+			return &node;
+		}
+
+		// Detaches the node from its parent and releases the rest of the tree it was in
+		void makeRoot(Node &node) {
+			if (node._parent == NO_NODE) {
+				return;
+			}
+			auto *root = &get(node._parent);
+			while (root->_parent != NO_NODE) {
+				root = &get(root->_parent);
+			}
+			unlink(node);
+			release(*root);
+		}
+
+		// Gives a node of an open loop tree, which has no state of its own, the state it has once it is the root
+		void setState(Node &node, std::shared_ptr<State> state) {
+			if (node._state == nullptr) {
+				++_stateCount;
+			}
+			node._state = std::move(state);
+			node.winProbabilities = node._state->getWinProbabilities();
+		}
+
+		// Releases the node and everything below it
+		void release(Node &node) {
+			unlink(node);
+			std::lock_guard guard(_mutex);
+			_released.push_back(node._index);
+			updateListBytes();
+		}
+
+		/*
+		 * Takes apart up to the number of released nodes, freeing their states so that a released tree does not keep
+		 * its memory until its nodes are reused. The states are freed outside of the lock, so that allocating nodes
+		 * does not wait for it. Returns the number of nodes reclaimed.
+		 */
+		std::size_t reclaim(const std::size_t limit) {
+			std::vector<std::shared_ptr<State> > states;
+			{
+				std::lock_guard guard(_mutex);
+				while (!_released.empty() && states.size() < limit) {
+					const auto index = _released.back();
+					_released.pop_back();
+					auto &node = get(index);
+					for (auto mask = node._childMask; mask != 0; mask &= mask - 1) {
+						_released.push_back(node._children[std::countr_zero(mask)]);
+					}
+					node._childMask = 0;
+					drop(node);
+					states.push_back(std::move(node._state));
+					_free.push_back(index);
+				}
+				updateListBytes();
+			}
+			return states.size();
+		}
+
+		/*
+		 * Gives the table an entry for every state below the root, holding the statistics of just those nodes, and
+		 * drops the entries of nodes no longer in the tree. The table is cleared first, so released nodes must never
+		 * read their entries again. Without a table the nodes stop sharing their statistics. No nodes may be created
+		 * or updated meanwhile.
+		 */
+		void rebuildTranspositions(Node &root) {
+			if (_transpositions != nullptr) {
+				_transpositions->clear();
+			}
+			std::vector<Node *> stack = {&root};
+			while (!stack.empty()) {
+				const auto node = stack.back();
+				stack.pop_back();
+				node->_transposition = nullptr;
+				if (_transpositions != nullptr && node->_state != nullptr) {
+					node->_transposition = &_transpositions->find(node->_state->hash());
+					node->_transposition->add(node->N, node->Q);
+				}
+				for (const auto child: node->getChildren()) {
+					stack.push_back(child);
+				}
+			}
+		}
+
+		// Releases every node at once
+		void clear() {
+			std::lock_guard guard(_mutex);
+			_size = 0;
+			_released.clear();
+			_free.clear();
+			_nodeCount = 0;
+			_stateCount = 0;
+		}
+
+		// Sets the table new nodes share their statistics through, or nullptr for none. No nodes may be created
+		// meanwhile.
+		void setTranspositionTable(TranspositionTable *transpositions) { _transpositions = transpositions; }
+
+		// Sets whether children are built without a state. No nodes may be created meanwhile.
+		void setOpenLoop(const bool openLoop) { _openLoop = openLoop; }
+		[[nodiscard]] bool isOpenLoop() const { return _openLoop; }
+
+		// The number of nodes in use, counting released ones until they are reclaimed or reused
+		[[nodiscard]] std::size_t size() const { return _nodeCount; }
+		// The number of those nodes that have a state of their own
+		[[nodiscard]] std::size_t stateCount() const { return _stateCount; }
+
+		// The number of nodes the allocated chunks have room for
+		[[nodiscard]] std::size_t capacity() const { return _chunkCount * CHUNK_SIZE; }
+		// The memory of the allocated chunks, the chunk table and the lists of released and free nodes
+		[[nodiscard]] std::size_t reservedBytes() const {
+			return capacity() * sizeof(Node) + MAX_CHUNKS * sizeof(std::unique_ptr<Node[]>) + _listBytes;
 		}
 	};
 
+	inline Node *Node::Children::iterator::operator*() const {
+		return &_pool->get((*_children)[std::countr_zero(_mask)]);
+	}
+
+	inline Node *Node::getParent() const {
+		return _parent == NO_NODE ? nullptr : &_pool->get(_parent);
+	}
+
+	inline Node *Node::getChild(const Action action) const {
+		if ((getChildMask() & actionBit(action)) == 0) {
+			return nullptr;
+		}
+		return &_pool->get(_children[static_cast<std::size_t>(action)]);
+	}
+
+	inline Node *Node::getOrAddChild(const Action action) {
+		if (const auto child = getChild(action); child != nullptr) {
+			return child;
+		}
+		// A detached copy has no pool to build children in
+		if ((getActionMask() & actionBit(action)) == 0 || _pool == nullptr) {
+			return nullptr;
+		}
+
+		// Another thread may have built the child while this one waited for the lock
+		std::lock_guard guard(*this);
+		if (const auto child = getChild(action); child != nullptr) {
+			return child;
+		}
+		if (_pool->isOpenLoop()) {
+			return _pool->create(action, this, nullptr);
+		}
+		const auto state = State::DeepCopy(*_state);
+		state->splitRandomStreams(*_state);
+		return _pool->create(action, this, state);
+	}
+
 	inline std::ostream &operator<<(std::ostream &os, const Node &node) {
 		os << node.toString();
 		return os;
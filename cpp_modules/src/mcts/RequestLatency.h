@@ -0,0 +1,109 @@
+#ifndef REQUESTLATENCY_H
+#define REQUESTLATENCY_H
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Sc2::Mcts {
+	// The calls into the search that hold the tree exclusively, waiting for the search threads to let go of it.
+	// Reading the results does not, it reads the latest snapshot instead.
+	enum class Request {
+		getRootNode,
+		setEndTime,
+		setLeafParallelism,
+		setSearchBatch,
+		setReuseTolerance,
+		setTranspositions,
+		setOpenLoop,
+		setMemoryBudget,
+		performAction,
+		updateRootState,
+		// Taken by a search thread, to adopt a root posted from Python
+		adoptRootState,
+		// Taken by a search thread, to prune the tree once it has reached the memory budget
+		pruneTree,
+		getRequestLatencies,
+		getTreeReuse,
+		// Not a request, the number of them
+		count,
+	};
+
+	constexpr std::size_t REQUEST_TYPES = static_cast<std::size_t>(Request::count);
+
+	// The name of the request as it is called from Python
+	inline std::string requestToString(const Request request) {
+		switch (request) {
+			case Request::getRootNode:
+				return "get_root_node";
+			case Request::setEndTime:
+				return "set_end_time";
+			case Request::setLeafParallelism:
+				return "set_leaf_parallelism";
+			case Request::setSearchBatch:
+				return "set_search_batch";
+			case Request::setReuseTolerance:
+				return "set_reuse_tolerance";
+			case Request::setTranspositions:
+				return "set_transpositions";
+			case Request::setOpenLoop:
+				return "set_open_loop";
+			case Request::setMemoryBudget:
+				return "set_memory_budget";
+			case Request::performAction:
+				return "perform_action";
+			case Request::updateRootState:
+				return "update_root_state";
+			case Request::adoptRootState:
+				return "adopt_root_state";
+			case Request::pruneTree:
+				return "prune_tree";
+			case Request::getRequestLatencies:
+				return "get_request_latencies";
+			case Request::getTreeReuse:
+				return "get_tree_reuse";
+			default:
+				return "unknown";
+		}
+	}
+
+	// The latency of a type of request in microseconds, over its most recent calls
+	struct RequestLatency {
+		std::string request;
+		std::size_t count = 0;
+		double p50 = 0;
+		double p99 = 0;
+	};
+
+	// Keeps the durations of the most recent calls in a ring, so that a long game does not grow it
+	class LatencyRecorder {
+		static constexpr std::size_t SAMPLES = 1024;
+
+		std::array<double, SAMPLES> _samples{};
+		std::size_t _count = 0;
+
+	public:
+		void record(const double microseconds) {
+			_samples[_count % SAMPLES] = microseconds;
+			_count++;
+		}
+
+		// The number of calls recorded, including the ones no longer kept
+		[[nodiscard]] std::size_t count() const { return _count; }
+
+		// The nearest rank percentile of the kept samples, where fraction is between 0 and 1
+		[[nodiscard]] double percentile(const double fraction) const {
+			const auto kept = std::min(_count, SAMPLES);
+			if (kept == 0) {
+				return 0;
+			}
+			std::vector samples(_samples.begin(), _samples.begin() + static_cast<std::ptrdiff_t>(kept));
+			const auto rank = std::min(kept - 1, static_cast<std::size_t>(fraction * static_cast<double>(kept)));
+			std::ranges::nth_element(samples, samples.begin() + static_cast<std::ptrdiff_t>(rank));
+			return samples[rank];
+		}
+	};
+}
+
+#endif //REQUESTLATENCY_H
@@ -0,0 +1,86 @@
+#ifndef TRANSPOSITIONTABLE_H
+#define TRANSPOSITIONTABLE_H
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace Sc2::Mcts {
+	/*
+	 * The statistics shared by every node whose state has the same hash, e.g. because it was reached by taking the
+	 * same actions in another order. The visits and the value are added to separately without a lock, so a reader
+	 * can see one of them a single update ahead of the other.
+	 */
+	class TranspositionEntry {
+		int _visits = 0;
+		double _totalValue = 0;
+
+	public:
+		[[nodiscard]] int getVisits() const {
+			return std::atomic_ref(const_cast<int &>(_visits)).load(std::memory_order_relaxed);
+		}
+		[[nodiscard]] double getTotalValue() const {
+			return std::atomic_ref(const_cast<double &>(_totalValue)).load(std::memory_order_relaxed);
+		}
+
+		void add(const int visits, const double totalValue) {
+			std::atomic_ref(_visits).fetch_add(visits, std::memory_order_relaxed);
+			std::atomic_ref(_totalValue).fetch_add(totalValue, std::memory_order_relaxed);
+		}
+	};
+
+	/*
+	 * The entries of the states that have been seen, by their hash. The table is split into shards that each have
+	 * their own lock, so that threads building nodes at the same time seldom wait for each other. Entries never
+	 * move once they are made, until the table is cleared, which the node pool does to rebuild it from the tree.
+	 */
+	class TranspositionTable {
+		static constexpr std::size_t SHARD_BITS = 6;
+
+		// Each on its own cache line, so that the locks of neighbouring shards are not shared between threads
+		struct alignas(64) Shard {
+			std::mutex mutex;
+			std::unordered_map<std::uint64_t, TranspositionEntry> entries;
+		};
+
+		std::array<Shard, std::size_t{1} << SHARD_BITS> _shards;
+		// Kept apart from the shards, so that it can be read without taking their locks
+		std::atomic<std::size_t> _size = 0;
+
+		// The shard is picked by the high bits, the map buckets by the low ones
+		Shard &shard(const std::uint64_t hash) { return _shards[hash >> (64 - SHARD_BITS)]; }
+
+	public:
+		// An estimate of the memory an entry takes, with the node of the map holding it and its bucket
+		static constexpr std::size_t ENTRY_BYTES =
+				sizeof(std::pair<const std::uint64_t, TranspositionEntry>) + 2 * sizeof(void *);
+
+		// The entry of the hash, which is made the first time the hash is seen
+		TranspositionEntry &find(const std::uint64_t hash) {
+			auto &[mutex, entries] = shard(hash);
+			std::lock_guard guard(mutex);
+			const auto [entry, inserted] = entries.try_emplace(hash);
+			if (inserted) {
+				++_size;
+			}
+			return entry->second;
+		}
+
+		// The number of states that have been seen
+		[[nodiscard]] std::size_t size() const { return _size; }
+
+		// Removes every entry, nodes that still refer to them must never read them again
+		void clear() {
+			for (auto &[mutex, entries]: _shards) {
+				std::lock_guard guard(mutex);
+				entries.clear();
+			}
+			_size = 0;
+		}
+	};
+}
+
+#endif //TRANSPOSITIONTABLE_H
@@ -0,0 +1,72 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Sc2::Mcts {
+	/*
+	 * A fixed set of threads that run submitted tasks in the order they were submitted. A task is told the index of
+	 * the thread running it, so it can use state that belongs to that thread alone.
+	 */
+	class WorkerPool {
+		std::vector<std::thread> _threads;
+		std::mutex _mutex;
+		std::condition_variable _condition;
+		std::deque<std::function<void(int)> > _tasks;
+		bool _stopping = false;
+
+		void work(const int worker) {
+			while (true) {
+				std::function<void(int)> task;
+				{
+					std::unique_lock lock(_mutex);
+					_condition.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+					if (_tasks.empty()) {
+						return;
+					}
+					task = std::move(_tasks.front());
+					_tasks.pop_front();
+				}
+				task(worker);
+			}
+		}
+
+	public:
+		explicit WorkerPool(const int threads) {
+			for (int worker = 0; worker < threads; worker++) {
+				_threads.emplace_back(&WorkerPool::work, this, worker);
+			}
+		}
+
+		WorkerPool(const WorkerPool &) = delete;
+		WorkerPool &operator=(const WorkerPool &) = delete;
+
+		// Finishes the tasks already submitted before the threads stop
+		~WorkerPool() {
+			{
+				std::lock_guard lock(_mutex);
+				_stopping = true;
+			}
+			_condition.notify_all();
+			for (auto &thread: _threads) {
+				thread.join();
+			}
+		}
+
+		[[nodiscard]] int size() const { return static_cast<int>(_threads.size()); }
+
+		void submit(std::function<void(int)> task) {
+			{
+				std::lock_guard lock(_mutex);
+				_tasks.push_back(std::move(task));
+			}
+			_condition.notify_one();
+		}
+	};
+}
+
+#endif //WORKERPOOL_H
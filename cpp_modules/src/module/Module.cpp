@@ -3,6 +3,7 @@
 #pragma once
 #include "Sc2State.h"
 #include "Mcts.h"
+#include "MctsEnsemble.h"
 
 namespace py = pybind11;
 
@@ -99,6 +100,18 @@ namespace pymodule {
 				.def("get_barracks_amount", &Sc2::State::getBarracksAmount)
 				.def_readwrite("id", &Sc2::State::id);
 
+		py::class_<Sc2::StateTolerance>(module, "StateTolerance")
+		.def(py::init<>())
+		.def(py::init([](const int resources, const int timers, const int enemyPower) {
+			return Sc2::StateTolerance{resources, timers, enemyPower};
+		}),
+			py::arg("resources"),
+			py::arg("timers"),
+			py::arg("enemy_power"))
+		.def_readwrite("resources", &Sc2::StateTolerance::resources)
+		.def_readwrite("timers", &Sc2::StateTolerance::timers)
+		.def_readwrite("enemy_power", &Sc2::StateTolerance::enemyPower);
+
 		py::class_<Sc2::Base>(module, "Base")
 		.def(py::init<const int, const int, const int, const int>(),
 			py::arg("id"),
@@ -148,10 +161,31 @@ namespace pymodule {
 		.def("get_time_left", &Sc2::Construction::getTimeLeft)
 		.def("to_string", &Sc2::Construction::toString);
 
-		py::class_<Sc2::Mcts::Node, std::shared_ptr<Sc2::Mcts::Node>>(module, "Node")
+		py::class_<Sc2::Mcts::Node>(module, "Node")
 		.def("to_string", &Sc2::Mcts::Node::toString)
 		.def("get_state", &Sc2::Mcts::Node::getState);
 
+		py::class_<Sc2::Mcts::RequestLatency>(module, "RequestLatency")
+		.def_readonly("request", &Sc2::Mcts::RequestLatency::request)
+		.def_readonly("count", &Sc2::Mcts::RequestLatency::count)
+		.def_readonly("p50", &Sc2::Mcts::RequestLatency::p50)
+		.def_readonly("p99", &Sc2::Mcts::RequestLatency::p99);
+
+		py::class_<Sc2::Mcts::Mcts::TreeReuse>(module, "TreeReuse")
+		.def_readonly("attempts", &Sc2::Mcts::Mcts::TreeReuse::attempts)
+		.def_readonly("hits", &Sc2::Mcts::Mcts::TreeReuse::hits)
+		.def_readonly("reused_visits", &Sc2::Mcts::Mcts::TreeReuse::reusedVisits)
+		.def_property_readonly("hit_rate", &Sc2::Mcts::Mcts::TreeReuse::hitRate);
+
+		py::class_<Sc2::Mcts::Mcts::TreeMemory>(module, "TreeMemory")
+		.def_readonly("nodes", &Sc2::Mcts::Mcts::TreeMemory::nodes)
+		.def_readonly("states", &Sc2::Mcts::Mcts::TreeMemory::states)
+		.def_readonly("transpositions", &Sc2::Mcts::Mcts::TreeMemory::transpositions)
+		.def_readonly("bytes", &Sc2::Mcts::Mcts::TreeMemory::bytes)
+		.def_readonly("budget", &Sc2::Mcts::Mcts::TreeMemory::budget)
+		.def_readonly("reserved_bytes", &Sc2::Mcts::Mcts::TreeMemory::reservedBytes)
+		.def_readonly("pruned_nodes", &Sc2::Mcts::Mcts::TreeMemory::prunedNodes);
+
 		py::class_<Sc2::Mcts::Mcts>(module, "Mcts") 
 		.def(py::init<const std::shared_ptr<Sc2::State>, const unsigned int, const int, const double, const ValueHeuristic, RolloutHeuristic, const int, const Sc2::ArmyValueFunction>(),
 			py::arg("state"),
@@ -166,16 +200,79 @@ namespace pymodule {
 			const std::shared_ptr<Sc2::State>& state
 			)>(&Sc2::Mcts::Mcts::updateRootState),
 			py::arg("state"))
+		.def("post_root_state", &Sc2::Mcts::Mcts::postRootState,
+			py::arg("state"), py::arg("actions") = std::vector<Action>())
+		.def("get_adopted_root", &Sc2::Mcts::Mcts::getAdoptedRoot)
+		.def("wait_for_root", &Sc2::Mcts::Mcts::waitForRoot,
+			py::arg("sequence"), py::call_guard<py::gil_scoped_release>())
 		.def("get_root_state", &Sc2::Mcts::Mcts::getRootState)
-		.def("get_root_node", &Sc2::Mcts::Mcts::getRootNode)
+		// Python gets a copy, the nodes of the tree are reused once the root moves on
+		.def("get_root_node", &Sc2::Mcts::Mcts::getRootNodeCopy)
 		.def("to_string", &Sc2::Mcts::Mcts::toString)
-		.def("start_search", &Sc2::Mcts::Mcts::startSearchThread)
+		.def("start_search", &Sc2::Mcts::Mcts::startSearchThread,
+			py::arg("threads") = 1)
 		.def("stop_search", &Sc2::Mcts::Mcts::stopSearchThread)
 		.def("start_search_rollout", &Sc2::Mcts::Mcts::startSearchRolloutThread,
-			py::arg("number_of_rollouts"))
+			py::arg("number_of_rollouts"), py::arg("threads") = 1)
+		.def("set_leaf_parallelism", &Sc2::Mcts::Mcts::setLeafParallelism,
+			py::arg("rollouts_per_leaf"), py::arg("workers"))
+		.def("set_search_batch", &Sc2::Mcts::Mcts::setSearchBatch,
+			py::arg("searches"))
+		.def("get_request_latencies", &Sc2::Mcts::Mcts::getRequestLatencies)
+		.def("set_reuse_tolerance", &Sc2::Mcts::Mcts::setReuseTolerance,
+			py::arg("tolerance"))
+		.def("get_tree_reuse", &Sc2::Mcts::Mcts::getTreeReuse)
+		.def("set_transpositions", &Sc2::Mcts::Mcts::setTranspositions,
+			py::arg("enabled"))
+		.def("get_transposition_count", &Sc2::Mcts::Mcts::getTranspositionCount)
+		.def("set_open_loop", &Sc2::Mcts::Mcts::setOpenLoop,
+			py::arg("open_loop"))
+		.def("is_open_loop", &Sc2::Mcts::Mcts::isOpenLoop)
+		.def("set_memory_budget", &Sc2::Mcts::Mcts::setMemoryBudget,
+			py::arg("bytes"))
+		.def("get_tree_memory", &Sc2::Mcts::Mcts::getTreeMemory)
 		.def("get_best_action", &Sc2::Mcts::Mcts::getBestAction)
 		.def("perform_action", &Sc2::Mcts::Mcts::performAction,
 			py::arg("action"))
 		.def("get_number_of_rollouts", &Sc2::Mcts::Mcts::getNumberOfRollouts); 
+
+		py::class_<Sc2::Mcts::MctsEnsemble>(module, "MctsEnsemble")
+		.def(py::init<const std::shared_ptr<Sc2::State>, const unsigned int, const int, const double, const ValueHeuristic, RolloutHeuristic, const int, const Sc2::ArmyValueFunction, const int>(),
+			py::arg("state"),
+			py::arg("seed"),
+			py::arg("rollout_end_time"),
+			py::arg("exploration"),
+			py::arg("value_heuristic"),
+			py::arg("rollout_heuristic"),
+			py::arg("end_probability_function"),
+			py::arg("army_value_function"),
+			py::arg("trees"))
+		.def("update_root_state", static_cast<void (Sc2::Mcts::MctsEnsemble::*)(
+			const std::shared_ptr<Sc2::State>& state
+			)>(&Sc2::Mcts::MctsEnsemble::updateRootState),
+			py::arg("state"))
+		.def("post_root_state", &Sc2::Mcts::MctsEnsemble::postRootState,
+			py::arg("state"), py::arg("actions") = std::vector<Action>())
+		.def("wait_for_root", &Sc2::Mcts::MctsEnsemble::waitForRoot,
+			py::arg("sequence"), py::call_guard<py::gil_scoped_release>())
+		.def("get_root_state", &Sc2::Mcts::MctsEnsemble::getRootState)
+		.def("get_tree_count", &Sc2::Mcts::MctsEnsemble::getTreeCount)
+		.def("set_reuse_tolerance", &Sc2::Mcts::MctsEnsemble::setReuseTolerance,
+			py::arg("tolerance"))
+		.def("get_tree_reuse", &Sc2::Mcts::MctsEnsemble::getTreeReuse)
+		.def("set_open_loop", &Sc2::Mcts::MctsEnsemble::setOpenLoop,
+			py::arg("open_loop"))
+		.def("set_memory_budget", &Sc2::Mcts::MctsEnsemble::setMemoryBudget,
+			py::arg("bytes"))
+		.def("get_tree_memory", &Sc2::Mcts::MctsEnsemble::getTreeMemory)
+		.def("to_string", &Sc2::Mcts::MctsEnsemble::toString)
+		.def("start_search", &Sc2::Mcts::MctsEnsemble::startSearchThread)
+		.def("stop_search", &Sc2::Mcts::MctsEnsemble::stopSearchThread)
+		.def("start_search_rollout", &Sc2::Mcts::MctsEnsemble::startSearchRolloutThread,
+			py::arg("number_of_rollouts"))
+		.def("get_best_action", &Sc2::Mcts::MctsEnsemble::getBestAction)
+		.def("perform_action", &Sc2::Mcts::MctsEnsemble::performAction,
+			py::arg("action"))
+		.def("get_number_of_rollouts", &Sc2::Mcts::MctsEnsemble::getNumberOfRollouts);
 	}
 }
@@ -3,50 +3,25 @@
 //
 #ifndef CONSTRUCTION_H
 #define CONSTRUCTION_H
-#include <memory>
-#include <utility>
 #include <sstream>
 #include "ActionEnum.h"
 
 
 namespace Sc2 {
-    class State;
-
-    typedef void (State::*ConstructionFunction)();
-
+    /*
+     * A construction as handed to the StateBuilder: the time left until it completes and the action that queued it.
+     */
     class Construction {
         int _timeLeft = 0;
-        bool _isFinished = false;
-        std::weak_ptr<State> _state;
         Action _action = Action::none;
-        ConstructionFunction _constructionFunction;
 
     public:
-        void setState(std::weak_ptr<State> state) { _state = std::move(state); }
-
-        Construction(const int constructionTime, std::weak_ptr<State> state,
-                     const ConstructionFunction constructionFunction): _timeLeft(constructionTime),
-                                                                       _state(std::move(state)),
-                                                                       _constructionFunction(constructionFunction) {
-        }
-
         Construction(const int constructionTime, const Action action);
 
-        [[nodiscard]] int getTimeLeft() const { return _timeLeft; }
-        [[nodiscard]] bool getIsFinished() const { return _isFinished; }
-        [[nodiscard]] ConstructionFunction getConstructionFunction() const { return _constructionFunction; }
+        Construction() = default;
 
-        void advanceTime(const int time) {
-            _timeLeft -= time;
-            if (_timeLeft <= 0) {
-                const auto state = _state.lock();
-
-                if (state != nullptr) {
-                    (state.get()->*_constructionFunction)();
-                    _isFinished = true;
-                }
-            }
-        }
+        [[nodiscard]] int getTimeLeft() const { return _timeLeft; }
+        [[nodiscard]] Action getAction() const { return _action; }
 
         [[nodiscard]] std::string toString() const {
             std::ostringstream str;
@@ -57,9 +32,6 @@ namespace Sc2 {
 
             return str.str();
         }
-
-
-        friend State;
     };
 }
 
@@ -0,0 +1,30 @@
+#ifndef ENUMARRAY_H
+#define ENUMARRAY_H
+#include <array>
+#include <cstddef>
+
+namespace Sc2 {
+	/*
+	 * A std::array indexed by the values of an enum, for enums whose values run from 0 to Size - 1.
+	 */
+	template<typename Enum, typename T, std::size_t Size>
+	struct EnumArray {
+		std::array<T, Size> values{};
+
+		static constexpr std::size_t size() { return Size; }
+
+		constexpr T &operator[](const Enum key) { return values[static_cast<std::size_t>(key)]; }
+		constexpr const T &operator[](const Enum key) const { return values[static_cast<std::size_t>(key)]; }
+
+		static constexpr Enum key(const std::size_t index) { return static_cast<Enum>(index); }
+
+		constexpr auto begin() { return values.begin(); }
+		constexpr auto end() { return values.end(); }
+		constexpr auto begin() const { return values.begin(); }
+		constexpr auto end() const { return values.end(); }
+
+		friend constexpr bool operator==(const EnumArray &left, const EnumArray &right) = default;
+	};
+}
+
+#endif //ENUMARRAY_H
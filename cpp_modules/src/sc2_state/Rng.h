@@ -0,0 +1,143 @@
+#ifndef RNG_H
+#define RNG_H
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+namespace Sc2 {
+	/*
+	 * The random number generator used by the State, the Enemy and the Mcts.
+	 * It is xoshiro256**, which keeps 32 bytes of state, so copying it along with a State is cheap.
+	 * It satisfies UniformRandomBitGenerator, so it can be used with the standard distributions as well.
+	 */
+	class Rng {
+		std::array<std::uint64_t, 4> _state{};
+
+		static constexpr std::uint64_t rotl(const std::uint64_t x, const int k) {
+			return (x << k) | (x >> (64 - k));
+		}
+
+		static constexpr std::uint64_t splitMix64(std::uint64_t &x) {
+			std::uint64_t z = (x += 0x9e3779b97f4a7c15);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+			return z ^ (z >> 31);
+		}
+
+	public:
+		using result_type = std::uint64_t;
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+		constexpr Rng() : Rng(0) {}
+
+		explicit constexpr Rng(std::uint64_t seed) {
+			for (auto &word: _state) {
+				word = splitMix64(seed);
+			}
+		}
+
+		constexpr result_type operator()() {
+			const auto result = rotl(_state[1] * 5, 7) * 9;
+			const auto t = _state[1] << 17;
+
+			_state[2] ^= _state[0];
+			_state[3] ^= _state[1];
+			_state[1] ^= _state[2];
+			_state[0] ^= _state[3];
+			_state[2] ^= t;
+			_state[3] = rotl(_state[3], 45);
+
+			return result;
+		}
+
+		// A uniformly distributed integer in [0, bound), using Lemire's multiply and reject method
+		constexpr std::uint32_t below(const std::uint32_t bound) {
+			auto product = static_cast<std::uint64_t>(static_cast<std::uint32_t>((*this)() >> 32)) * bound;
+			auto low = static_cast<std::uint32_t>(product);
+			if (low < bound) {
+				const std::uint32_t threshold = -bound % bound;
+				while (low < threshold) {
+					product = static_cast<std::uint64_t>(static_cast<std::uint32_t>((*this)() >> 32)) * bound;
+					low = static_cast<std::uint32_t>(product);
+				}
+			}
+			return static_cast<std::uint32_t>(product >> 32);
+		}
+
+		// A uniformly distributed double in [0, 1)
+		constexpr double uniform() {
+			return static_cast<double>((*this)() >> 11) * 0x1.0p-53;
+		}
+
+		/*
+		 * The number of successes out of n trials of probability p. Inversion takes a single draw and a walk of
+		 * about n * p steps, so it is used while that is small and the standard distribution otherwise.
+		 */
+		int binomial(const int n, const double p) {
+			if (n <= 0 || p <= 0) {
+				return 0;
+			}
+			if (p >= 1) {
+				return n;
+			}
+			if (p > 0.5) {
+				return n - binomial(n, 1 - p);
+			}
+			if (n * p > 100) {
+				return std::binomial_distribution(n, p)(*this);
+			}
+
+			const auto ratio = p / (1 - p);
+			auto probability = std::pow(1 - p, n);
+			auto draw = uniform();
+			int successes = 0;
+			while (draw >= probability && successes < n) {
+				draw -= probability;
+				probability *= ratio * (n - successes) / (successes + 1);
+				successes++;
+			}
+			return successes;
+		}
+
+		/*
+		 * Advances the generator by 2^128 draws. Generators jumped a different number of times from the same
+		 * starting point produce non-overlapping streams, which is meant for giving threads a stream each.
+		 */
+		constexpr void jump() {
+			constexpr std::array<std::uint64_t, 4> polynomial = {
+				0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c
+			};
+
+			std::array<std::uint64_t, 4> jumped{};
+			for (const auto word: polynomial) {
+				for (int bit = 0; bit < 64; bit++) {
+					if (word & (std::uint64_t{1} << bit)) {
+						for (int i = 0; i < 4; i++) {
+							jumped[i] ^= _state[i];
+						}
+					}
+					(*this)();
+				}
+			}
+			_state = jumped;
+		}
+
+		/*
+		 * A new generator seeded from this one, which also advances this one. Unlike jump it can be nested
+		 * arbitrarily deep, which is what child states in the search tree need.
+		 */
+		constexpr Rng split() {
+			const auto high = (*this)();
+			const auto low = (*this)();
+			return Rng(high ^ rotl(low, 32));
+		}
+
+		friend constexpr bool operator==(const Rng &left, const Rng &right) = default;
+	};
+}
+
+#endif //RNG_H
@@ -10,4 +10,9 @@ static constexpr int MINERAL_PER_WORKER = 1;
 static constexpr int VESPENE_PER_WORKER = 1;
 static constexpr int TANK_SUPPLY = 3;
 static constexpr int VIKING_SUPPLY = 2;
+
+// Capacities of the inline arrays in a State, chosen well above what a game or a rollout reaches
+static constexpr int MAX_BASES_CAPACITY = 17;
+static constexpr int MAX_CONSTRUCTIONS = 64;
+static constexpr int MAX_OCCUPIED_WORKERS = 64;
 #endif //SC2CONSTANTS_H
@@ -1,41 +1,206 @@
 #include "Sc2State.h"
 
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
 std::shared_ptr<Sc2::State> Sc2::State::DeepCopy(const State &state, const bool onRollout) {
     auto copyState = std::make_shared<State>(state);
+    copyState->_onRollout = onRollout;
 
-    const auto stateConstructions = state.getConstructions();
-    for (const auto &stateConstruction: stateConstructions) {
-        copyState->_constructions.emplace_back(
-            stateConstruction._timeLeft, copyState, stateConstruction._constructionFunction);
+    return copyState;
+}
+
+void Sc2::State::advanceConstructions() {
+    // Each worker advances one construction in the order they were queued, and at least one always advances
+    const auto advanced = static_cast<size_t>(std::max(1, _workerPopulation));
+    _constructions.advance(_currentTime, 0, advanced, [this](const Action action) {
+        completeConstruction(action);
+    });
+}
+
+void Sc2::State::completeConstruction(const Action action) {
+    switch (action) {
+        case Action::buildWorker:
+            addWorker();
+            break;
+        case Action::buildBarracks:
+            addBarracks();
+            break;
+        case Action::buildHouse:
+            addHouse();
+            break;
+        case Action::buildBase:
+            addBase();
+            break;
+        case Action::buildVespeneCollector:
+            addVespeneCollector();
+            break;
+        case Action::buildMarine:
+            addMarine();
+            break;
+        case Action::buildFactory:
+            addFactory();
+            break;
+        case Action::buildTank:
+            addTank();
+            break;
+        case Action::buildViking:
+            addViking();
+            break;
+        case Action::buildStarPort:
+            addStarPort();
+            break;
+        case Action::none:
+            throw std::invalid_argument("Action::none");
+        default:
+            throw std::runtime_error("No Construction action" + actionToString(action));
     }
+}
 
-    const auto stateBases = state.getBases();
-    for (const auto &base: stateBases) {
-        copyState->_bases.emplace_back(base);
+std::vector<Sc2::Construction> Sc2::State::getConstructions() const {
+    std::vector<Construction> constructions;
+    constructions.reserve(_constructions.size());
+    for (const auto &construction: _constructions.inOrder()) {
+        constructions.emplace_back(construction.completionTime - _currentTime, construction.value);
     }
+    return constructions;
+}
 
-    copyState->_onRollout = onRollout;
+std::vector<int> Sc2::State::getOccupiedWorkerTimers() const {
+    std::vector<int> timers;
+    timers.reserve(_occupiedWorkerTimers.size());
+    for (const auto &timer: _occupiedWorkerTimers.inOrder()) {
+        timers.emplace_back(timer.completionTime - _currentTime);
+    }
+    return timers;
+}
 
-    return copyState;
+namespace {
+    // The timers as actions and the time left on them, ordered so that timers of the same action can be paired up
+    template<typename Queue>
+    std::vector<std::pair<Action, int> > remainingTimers(const Queue &queue, const int currentTime) {
+        std::vector<std::pair<Action, int> > timers;
+        timers.reserve(queue.size());
+        for (const auto &timer: queue.inOrder()) {
+            timers.emplace_back(timer.value, timer.completionTime - currentTime);
+        }
+        std::ranges::sort(timers);
+        return timers;
+    }
+
+    template<typename Queue>
+    bool timersMatch(const Queue &left, const int leftTime, const Queue &right, const int rightTime,
+                     const int tolerance) {
+        if (left.size() != right.size()) {
+            return false;
+        }
+        const auto leftTimers = remainingTimers(left, leftTime);
+        const auto rightTimers = remainingTimers(right, rightTime);
+        for (size_t i = 0; i < leftTimers.size(); i++) {
+            if (leftTimers[i].first != rightTimers[i].first ||
+                std::abs(leftTimers[i].second - rightTimers[i].second) > tolerance) {
+                return false;
+            }
+        }
+        return true;
+    }
 }
 
-void Sc2::State::advanceConstructions() {
-    if (_constructions.empty()) {
-        return;
+namespace {
+    // The fields of the state that are hashed, each of which gets keys of its own
+    enum class HashField : std::uint64_t {
+        minerals, vespene, currentTime, workerPopulation, marinePopulation, tankPopulation, vikingPopulation,
+        incomingWorkers, incomingMarines, incomingTanks, incomingVikings, incomingVespeneCollectors, populationLimit,
+        barracksAmount, factoryAmount, starPortAmount, hasHouse, incomingHouse, incomingBarracks, incomingFactory,
+        incomingBases, base, construction, occupiedWorker,
+    };
+
+    // The random key of a value of a field, the SplitMix64 finaliser of the two together
+    std::uint64_t zobristKey(const HashField field, const std::uint64_t value) {
+        auto z = (static_cast<std::uint64_t>(field) << 48 ^ value) + 0x9e3779b97f4a7c15;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
     }
 
-    auto constructionIter = _constructions.begin();
-    int availableWorkers = _workerPopulation;
+    std::uint64_t zobristKey(const HashField field, const int value) {
+        return zobristKey(field, static_cast<std::uint64_t>(static_cast<std::uint32_t>(value)));
+    }
 
-    do {
-        constructionIter->advanceTime(1);
-        if (constructionIter->getIsFinished()) {
-            constructionIter = _constructions.erase(constructionIter);
-        } else {
-            ++constructionIter;
+    // The keys of the timers, summed so that their order does not matter and the queue need not be sorted
+    template<typename Queue>
+    std::uint64_t timerKeys(const Queue &queue, const HashField field, const int currentTime) {
+        std::uint64_t keys = 0;
+        for (const auto &timer: queue) {
+            const auto remaining = static_cast<std::uint32_t>(timer.completionTime - currentTime);
+            keys += zobristKey(field, static_cast<std::uint64_t>(timer.value) << 32 | remaining);
         }
-        availableWorkers--;
-    } while ((constructionIter != _constructions.end()) && (availableWorkers > 0));
+        return keys;
+    }
+}
+
+std::uint64_t Sc2::State::hash() const {
+    std::uint64_t hash = zobristKey(HashField::minerals, _minerals) +
+                         zobristKey(HashField::vespene, _vespene) +
+                         zobristKey(HashField::currentTime, _currentTime) +
+                         zobristKey(HashField::workerPopulation, _workerPopulation) +
+                         zobristKey(HashField::marinePopulation, _marinePopulation) +
+                         zobristKey(HashField::tankPopulation, _tankPopulation) +
+                         zobristKey(HashField::vikingPopulation, _vikingPopulation) +
+                         zobristKey(HashField::incomingWorkers, _incomingWorkers) +
+                         zobristKey(HashField::incomingMarines, _incomingMarines) +
+                         zobristKey(HashField::incomingTanks, _incomingTanks) +
+                         zobristKey(HashField::incomingVikings, _incomingVikings) +
+                         zobristKey(HashField::incomingVespeneCollectors, _incomingVespeneCollectors) +
+                         zobristKey(HashField::populationLimit, _populationLimit) +
+                         zobristKey(HashField::barracksAmount, _barracksAmount) +
+                         zobristKey(HashField::factoryAmount, _factoryAmount) +
+                         zobristKey(HashField::starPortAmount, _starPortAmount) +
+                         zobristKey(HashField::hasHouse, _hasHouse) +
+                         zobristKey(HashField::incomingHouse, _incomingHouse) +
+                         zobristKey(HashField::incomingBarracks, _incomingBarracks) +
+                         zobristKey(HashField::incomingFactory, _incomingFactory) +
+                         zobristKey(HashField::incomingBases, _incomingBases);
+    for (size_t i = 0; i < _bases.size(); i++) {
+        const auto &base = _bases[i];
+        hash += zobristKey(HashField::base, static_cast<std::uint64_t>(i) << 24 |
+                                            static_cast<std::uint64_t>(base.mineralFields) << 16 |
+                                            static_cast<std::uint64_t>(base.vespeneGeysers) << 8 |
+                                            static_cast<std::uint64_t>(base.vespeneCollectors));
+    }
+    return hash + timerKeys(_constructions, HashField::construction, _currentTime) +
+           timerKeys(_occupiedWorkerTimers, HashField::occupiedWorker, _currentTime);
+}
+
+bool Sc2::State::matches(const State &other, const StateTolerance &tolerance) const {
+    const auto close = [](const int left, const int right, const int limit) { return std::abs(left - right) <= limit; };
+
+    if (_workerPopulation != other._workerPopulation || _marinePopulation != other._marinePopulation ||
+        _tankPopulation != other._tankPopulation || _vikingPopulation != other._vikingPopulation ||
+        _incomingWorkers != other._incomingWorkers || _incomingMarines != other._incomingMarines ||
+        _incomingTanks != other._incomingTanks || _incomingVikings != other._incomingVikings ||
+        _populationLimit != other._populationLimit || _barracksAmount != other._barracksAmount ||
+        _factoryAmount != other._factoryAmount || _starPortAmount != other._starPortAmount ||
+        _hasHouse != other._hasHouse || _incomingHouse != other._incomingHouse ||
+        _incomingBarracks != other._incomingBarracks || _incomingFactory != other._incomingFactory ||
+        _incomingBases != other._incomingBases || _bases.size() != other._bases.size() ||
+        getVespeneCollectorsAmount() != other.getVespeneCollectorsAmount()) {
+        return false;
+    }
+
+    if (!close(_minerals, other._minerals, tolerance.resources) ||
+        !close(_vespene, other._vespene, tolerance.resources) ||
+        !close(_currentTime, other._currentTime, tolerance.timers) ||
+        !close(_enemy.groundPower, other._enemy.groundPower, tolerance.enemyPower) ||
+        !close(_enemy.airPower, other._enemy.airPower, tolerance.enemyPower)) {
+        return false;
+    }
+
+    return timersMatch(_constructions, _currentTime, other._constructions, other._currentTime, tolerance.timers) &&
+           timersMatch(_occupiedWorkerTimers, _currentTime, other._occupiedWorkerTimers, other._currentTime,
+                       tolerance.timers);
 }
 
 void Sc2::State::advanceResources() {
@@ -44,19 +209,10 @@ void Sc2::State::advanceResources() {
 }
 
 void Sc2::State::advanceOccupiedWorkers() {
-    int availableWorkers = _workerPopulation;
-
-    const auto lastIndex = static_cast<int>(_occupiedWorkerTimers.size()) - 1;
-
-
-    for (int i = lastIndex; i >= 0 && availableWorkers > 0; i--) {
-        _occupiedWorkerTimers[i] -= 1;
-        availableWorkers--;
-
-        if (_occupiedWorkerTimers[i] <= 0) {
-            _occupiedWorkerTimers.erase(_occupiedWorkerTimers.begin() + i);
-        }
-    }
+    // Only the most recently occupied workers advance, one for each worker
+    const auto occupied = _occupiedWorkerTimers.size();
+    const auto advanced = std::min(occupied, static_cast<size_t>(std::max(0, _workerPopulation)));
+    _occupiedWorkerTimers.advance(_currentTime, occupied - advanced, advanced, [](Action) {});
 }
 
 void Sc2::State::advanceEnemyAction() {
@@ -81,6 +237,62 @@ void Sc2::State::wait(const int amount) {
     }
 }
 
+std::optional<int> Sc2::State::quietTimesteps() const {
+    if (_constructions.empty() && _occupiedWorkerTimers.empty()) {
+        return std::nullopt;
+    }
+
+    const auto workers = static_cast<size_t>(std::max(0, _workerPopulation));
+    if (_constructions.size() > std::max<size_t>(1, workers) || _occupiedWorkerTimers.size() > workers) {
+        return 0;
+    }
+
+    int nextCompletion = std::numeric_limits<int>::max();
+    if (!_constructions.empty()) {
+        nextCompletion = _constructions.nextCompletionTime();
+    }
+    if (!_occupiedWorkerTimers.empty()) {
+        nextCompletion = std::min(nextCompletion, _occupiedWorkerTimers.nextCompletionTime());
+    }
+
+    return std::max(0, nextCompletion - _currentTime - 1);
+}
+
+void Sc2::State::skipQuietTimesteps(const int limit) {
+    const auto quiet = quietTimesteps();
+    const int timesteps = quiet ? std::min(*quiet, limit) : limit;
+    if (timesteps <= 0) {
+        return;
+    }
+
+    // Nothing completes in these timesteps, so the income stays the same and the enemy acts on its own
+    const int startTime = _currentTime;
+    _minerals += timesteps * mineralGainedPerTimestep();
+    _vespene += timesteps * vespeneGainedPerTimestep();
+    _currentTime += timesteps;
+    _enemy.advance(startTime, _currentTime);
+}
+
+void Sc2::State::skipQuietTimestepsUntilAffordable(const ActionCost &actionCost) {
+    // The wait loops give up after a timestep without income for a resource, so only skip while there is income
+    // for every resource the action costs
+    const int mineralIncome = mineralGainedPerTimestep();
+    const int vespeneIncome = vespeneGainedPerTimestep();
+    if ((actionCost.minerals > 0 && mineralIncome <= 0) || (actionCost.vespene > 0 && vespeneIncome <= 0)) {
+        return;
+    }
+
+    int timesteps = 0;
+    if (_minerals < actionCost.minerals) {
+        timesteps = (actionCost.minerals - _minerals + mineralIncome - 1) / mineralIncome;
+    }
+    if (_vespene < actionCost.vespene) {
+        timesteps = std::max(timesteps, (actionCost.vespene - _vespene + vespeneIncome - 1) / vespeneIncome);
+    }
+
+    skipQuietTimesteps(timesteps - 1);
+}
+
 int Sc2::State::getVespeneCollectorsAmount() const {
     int vespeneCollectors = 0;
     for (const auto &base: _bases) {
@@ -249,9 +461,9 @@ std::vector<Action> Sc2::State::getLegalActions() const {
     return actions;
 }
 
-std::tuple<double, double, double> Sc2::State::getWinProbabilities() {
-    const double successProb = getCombatSuccessProbability();
-    const double endProb = getEndProbability();
+std::tuple<double, double, double> Sc2::State::getWinProbabilities(const Evaluation &evaluation) {
+    const double successProb = evaluation.combatSuccess;
+    const double endProb = evaluation.end;
 
     double winProb = successProb * endProb;
     double lossProb = (1 - successProb) * endProb;
@@ -260,37 +472,125 @@ std::tuple<double, double, double> Sc2::State::getWinProbabilities() {
     return {winProb, lossProb, continueProb};
 }
 
-double Sc2::State::getCombatSuccessProbability() const {
-    switch (_armyValueFunction) {
-        case ArmyValueFunction::AveragePower:
-            return getValueArmyPowerAverage();
-        case ArmyValueFunction::MinPower:
-            return getValueMinArmyPower();
-        case ArmyValueFunction::ScaledPower:
-            return getValueArmyPowerScaled();
-        case ArmyValueFunction::MarinePower:
-            return getValueMarines();
-        case ArmyValueFunction::None:
-            throw std::invalid_argument("ArmyValueFunction::None");
-        default:
-            throw std::invalid_argument("Unknown ArmyValueFunction");
+namespace {
+    // The softmax of the first of two values, exp(first) / (exp(first) + exp(second))
+    double softmaxFirst(const double first, const double second) {
+        return 1 / (1 + std::exp(second - first));
     }
-}
-
-double Sc2::State::getEndProbability() const {
-    const double successProb = getCombatSuccessProbability();
 
-    switch (END_PROBABILITY_FUNCTION) {
-        case 0:
-            return std::pow(successProb - 0.5, 2) * 4;
-        case 1:
-            return std::pow(successProb - 0.5, 4) * 16;
-        case 2:
-            return std::pow(successProb - 0.5, 8) * 200;
-        default:
-            throw std::runtime_error("Unknown EndProbabilityFunction: " + std::to_string(END_PROBABILITY_FUNCTION));
+    template<int Exponent>
+    constexpr double integerPower(const double value) {
+        double result = 1;
+        for (int i = 0; i < Exponent; i++) {
+            result *= value;
+        }
+        return result;
+    }
+}
+
+template<Sc2::ArmyValueFunction Function>
+double Sc2::State::combatSuccessProbability(const State &state) {
+    if constexpr (Function == ArmyValueFunction::MarinePower) {
+        return softmaxFirst(static_cast<double>(state._marinePopulation) / 4,
+                            static_cast<double>(state._enemy.enemyCombatUnits) / 4);
+    } else {
+        //this assumes the vikings can attack both air and ground at the same time
+        const auto groundSoftMax = softmaxFirst(static_cast<double>(state.calculateGroundPower()) / 4,
+                                                static_cast<double>(state._enemy.groundPower) / 4);
+        const auto airSoftMax = softmaxFirst(static_cast<double>(state.calculateAirPower()) / 4,
+                                             static_cast<double>(state._enemy.airPower) / 4);
+        if constexpr (Function == ArmyValueFunction::MinPower) {
+            return std::min(groundSoftMax, airSoftMax);
+        } else if constexpr (Function == ArmyValueFunction::AveragePower) {
+            return (airSoftMax + groundSoftMax) / 2;
+        } else {
+            static_assert(Function == ArmyValueFunction::ScaledPower);
+            const auto average = (airSoftMax + groundSoftMax) / 2;
+            const auto difference = std::abs(airSoftMax - groundSoftMax);
+            return average * (1 - difference);
+        }
     }
+}
 
+template<int Function>
+double Sc2::State::endProbability(const double combatSuccess) {
+    if constexpr (Function == 0) {
+        return integerPower<2>(combatSuccess - 0.5) * 4;
+    } else if constexpr (Function == 1) {
+        return integerPower<4>(combatSuccess - 0.5) * 16;
+    } else {
+        static_assert(Function == 2);
+        return integerPower<8>(combatSuccess - 0.5) * 200;
+    }
+}
+
+template<Sc2::ArmyValueFunction ArmyFunction, int EndFunction>
+Sc2::State::Evaluation Sc2::State::evaluate(const State &state) {
+    const auto combatSuccess = combatSuccessProbability<ArmyFunction>(state);
+    return {combatSuccess, endProbability<EndFunction>(combatSuccess)};
+}
+
+double Sc2::State::unsupportedCombatSuccess(const State &state) {
+    if (state._armyValueFunction == ArmyValueFunction::None) {
+        throw std::invalid_argument("ArmyValueFunction::None");
+    }
+    throw std::invalid_argument("Unknown ArmyValueFunction");
+}
+
+Sc2::State::Evaluation Sc2::State::unsupportedEvaluation(const State &state) {
+    state._combatSuccessFunction(state);
+    throw std::runtime_error("Unknown EndProbabilityFunction: " + std::to_string(state.END_PROBABILITY_FUNCTION));
+}
+
+void Sc2::State::selectEvaluation() {
+    using EvaluationRow = std::array<EvaluationFunction, END_PROBABILITY_FUNCTIONS>;
+    struct Specialisation {
+        ArmyValueFunction armyValueFunction;
+        CombatSuccessFunction combatSuccess;
+        EvaluationRow evaluations;
+    };
+    static constexpr std::array specialisations = {
+        Specialisation{
+            ArmyValueFunction::AveragePower, &combatSuccessProbability<ArmyValueFunction::AveragePower>,
+            {
+                &evaluate<ArmyValueFunction::AveragePower, 0>, &evaluate<ArmyValueFunction::AveragePower, 1>,
+                &evaluate<ArmyValueFunction::AveragePower, 2>
+            }
+        },
+        Specialisation{
+            ArmyValueFunction::MinPower, &combatSuccessProbability<ArmyValueFunction::MinPower>,
+            {
+                &evaluate<ArmyValueFunction::MinPower, 0>, &evaluate<ArmyValueFunction::MinPower, 1>,
+                &evaluate<ArmyValueFunction::MinPower, 2>
+            }
+        },
+        Specialisation{
+            ArmyValueFunction::ScaledPower, &combatSuccessProbability<ArmyValueFunction::ScaledPower>,
+            {
+                &evaluate<ArmyValueFunction::ScaledPower, 0>, &evaluate<ArmyValueFunction::ScaledPower, 1>,
+                &evaluate<ArmyValueFunction::ScaledPower, 2>
+            }
+        },
+        Specialisation{
+            ArmyValueFunction::MarinePower, &combatSuccessProbability<ArmyValueFunction::MarinePower>,
+            {
+                &evaluate<ArmyValueFunction::MarinePower, 0>, &evaluate<ArmyValueFunction::MarinePower, 1>,
+                &evaluate<ArmyValueFunction::MarinePower, 2>
+            }
+        },
+    };
+
+    _combatSuccessFunction = &unsupportedCombatSuccess;
+    _evaluationFunction = &unsupportedEvaluation;
+    for (const auto &specialisation: specialisations) {
+        if (specialisation.armyValueFunction != _armyValueFunction) {
+            continue;
+        }
+        _combatSuccessFunction = specialisation.combatSuccess;
+        if (END_PROBABILITY_FUNCTION >= 0 && END_PROBABILITY_FUNCTION < END_PROBABILITY_FUNCTIONS) {
+            _evaluationFunction = specialisation.evaluations[END_PROBABILITY_FUNCTION];
+        }
+    }
 }
 
 void Sc2::State::addVespeneCollector() {
@@ -310,10 +610,12 @@ void Sc2::State::buildBarracks() {
         if (!_incomingHouse) {
             return;
         }
+        skipQuietTimesteps(quietTimesteps().value_or(0));
         advanceTime();
     }
 
     while (!canAffordConstruction(buildBarracksCost)) {
+        skipQuietTimestepsUntilAffordable(buildBarracksCost);
         const auto initialMineral = _minerals;
         advanceTime();
         if (initialMineral == _minerals) {
@@ -322,19 +624,25 @@ void Sc2::State::buildBarracks() {
     }
 
     while (!hasUnoccupiedWorker()) {
+        if (_workerPopulation + _incomingWorkers > 0) {
+            skipQuietTimesteps(quietTimesteps().value_or(0));
+        }
         advanceTime();
         if (_workerPopulation + _incomingWorkers <= 0) {
             return;
         }
     }
 
+    if (!canQueueBuilding()) {
+        return;
+    }
 
     _minerals -= buildBarracksCost.minerals;
     _vespene -= buildBarracksCost.vespene;
     _incomingBarracks = true;
 
-    _occupiedWorkerTimers.emplace_back(buildBarracksCost.buildTime);
-    _constructions.emplace_back(buildBarracksCost.buildTime, shared_from_this(), &State::addBarracks);
+    occupyWorker(buildBarracksCost.buildTime, Action::buildBarracks);
+    queueConstruction(buildBarracksCost.buildTime, Action::buildBarracks);
 }
 
 void Sc2::State::buildFactory()
@@ -343,11 +651,13 @@ void Sc2::State::buildFactory()
         if (!_incomingBarracks) {
             return;
         }
+        skipQuietTimesteps(quietTimesteps().value_or(0));
         advanceTime();
     }
 
     while (!canAffordConstruction(buildFactoryCost))
     {
+        skipQuietTimestepsUntilAffordable(buildFactoryCost);
         const auto initialMineral = _minerals;
         const auto initialVespene = _vespene;
         advanceTime();
@@ -358,18 +668,25 @@ void Sc2::State::buildFactory()
 
     while (!hasUnoccupiedWorker())
     {
+        if (_workerPopulation + _incomingWorkers > 0) {
+            skipQuietTimesteps(quietTimesteps().value_or(0));
+        }
         advanceTime();
         if (_workerPopulation + _incomingWorkers <= 0) {
             return;
         }
     }
 
+    if (!canQueueBuilding()) {
+        return;
+    }
+
     _minerals -= buildFactoryCost.minerals;
     _vespene -= buildFactoryCost.vespene;
     _incomingFactory += 1;
 
-    _occupiedWorkerTimers.emplace_back(buildFactoryCost.buildTime);
-    _constructions.emplace_back(buildFactoryCost.buildTime, shared_from_this(), &State::addFactory);
+    occupyWorker(buildFactoryCost.buildTime, Action::buildFactory);
+    queueConstruction(buildFactoryCost.buildTime, Action::buildFactory);
 }
 
 // void Sc2::State::buildFactoryTechLab()
@@ -404,11 +721,13 @@ void Sc2::State::buildStarPort()
         if (_incomingFactory <= 0) {
             return;
         }
+        skipQuietTimesteps(quietTimesteps().value_or(0));
         advanceTime();
     }
 
     while (!canAffordConstruction(buildStarPortCost))
     {
+        skipQuietTimestepsUntilAffordable(buildStarPortCost);
         const auto initialMineral = _minerals;
         const auto initialVespene = _vespene;
         advanceTime();
@@ -419,17 +738,24 @@ void Sc2::State::buildStarPort()
 
     while (!hasUnoccupiedWorker())
     {
+        if (_workerPopulation + _incomingWorkers > 0) {
+            skipQuietTimesteps(quietTimesteps().value_or(0));
+        }
         advanceTime();
         if (_workerPopulation + _incomingWorkers <= 0) {
             return;
         }
     }
 
+    if (!canQueueBuilding()) {
+        return;
+    }
+
     _minerals -= buildStarPortCost.minerals;
     _vespene -= buildStarPortCost.vespene;
 
-    _occupiedWorkerTimers.emplace_back(buildStarPortCost.vespene);
-    _constructions.emplace_back(buildFactoryCost.buildTime, shared_from_this(), &State::addStarPort);
+    occupyWorker(buildStarPortCost.vespene, Action::buildStarPort);
+    queueConstruction(buildFactoryCost.buildTime, Action::buildStarPort);
 }
 
 
@@ -438,10 +764,12 @@ void Sc2::State::buildMarine() {
         if (!_incomingBarracks) {
             return;
         }
+        skipQuietTimesteps(quietTimesteps().value_or(0));
         advanceTime();
     }
 
     while (!canAffordConstruction(buildMarineCost)) {
+        skipQuietTimestepsUntilAffordable(buildMarineCost);
         const auto initialMineral = _minerals;
         advanceTime();
         if (initialMineral == _minerals) {
@@ -450,17 +778,19 @@ void Sc2::State::buildMarine() {
     }
 
     while (!hasFreeBarracks()) {
+        if (_barracksAmount >= 1) {
+            skipQuietTimesteps(quietTimesteps().value_or(0));
+        }
         advanceTime();
         if (_barracksAmount < 1) return;
     }
 
-    if (!populationLimitReached()) {
+    if (!populationLimitReached() && canQueueConstruction()) {
         _minerals -= buildMarineCost.minerals;
         _vespene -= buildMarineCost.vespene;
         _incomingMarines += 1;
 
-        auto c = Construction(buildMarineCost.buildTime, shared_from_this(), &State::addMarine);
-        _constructions.emplace_back(c);
+        queueConstruction(buildMarineCost.buildTime, Action::buildMarine);
     }
 }
 
@@ -470,16 +800,21 @@ void Sc2::State::buildTank()
         if (_incomingFactory <= 0) {
             return;
         }
+        skipQuietTimesteps(quietTimesteps().value_or(0));
         advanceTime();
     }
 
     while (!hasFreeFactory())
     {
+        if (_factoryAmount >= 1) {
+            skipQuietTimesteps(quietTimesteps().value_or(0));
+        }
         advanceTime();
         if (_factoryAmount < 1) return;
     }
 
     while (!canAffordConstruction(buildTankCost)) {
+        skipQuietTimestepsUntilAffordable(buildTankCost);
         const auto initialMineral = _minerals;
         const auto initialVespene = _vespene;
         advanceTime();
@@ -488,14 +823,13 @@ void Sc2::State::buildTank()
         }
     }
 
-    if (withinPopulationLimit(TANK_SUPPLY))
+    if (withinPopulationLimit(TANK_SUPPLY) && canQueueConstruction())
     {
         _minerals -= buildTankCost.minerals;
         _vespene -= buildTankCost.vespene;
         _incomingTanks += 1;
 
-        auto c = Construction(buildTankCost.buildTime, shared_from_this(), &State::addTank);
-        _constructions.emplace_back(c);
+        queueConstruction(buildTankCost.buildTime, Action::buildTank);
     }
 }
 
@@ -507,6 +841,7 @@ void Sc2::State::buildViking()
     }
 
     while (!canAffordConstruction(buildVikingCost)) {
+        skipQuietTimestepsUntilAffordable(buildVikingCost);
         const auto initialMineral = _minerals;
         const auto initialVespene = _vespene;
         advanceTime();
@@ -517,23 +852,26 @@ void Sc2::State::buildViking()
 
     while (!hasFreeStarPort())
     {
+        if (_starPortAmount >= 1) {
+            skipQuietTimesteps(quietTimesteps().value_or(0));
+        }
         advanceTime();
         if (_starPortAmount < 1) return;
     }
 
-    if (withinPopulationLimit(VIKING_SUPPLY))
+    if (withinPopulationLimit(VIKING_SUPPLY) && canQueueConstruction())
     {
         _minerals -= buildVikingCost.minerals;
         _vespene -= buildVikingCost.vespene;
         _incomingVikings += 1;
 
-        auto c = Construction(buildVikingCost.buildTime, shared_from_this(), &State::addViking);
-        _constructions.emplace_back(c);
+        queueConstruction(buildVikingCost.buildTime, Action::buildViking);
     }
 }
 
 void Sc2::State::buildVespeneCollector() {
     while (!canAffordConstruction(buildVespeneCollectorCost)) {
+        skipQuietTimestepsUntilAffordable(buildVespeneCollectorCost);
         const auto initialMineral = _minerals;
         advanceTime();
         if (initialMineral == _minerals) {
@@ -542,27 +880,28 @@ void Sc2::State::buildVespeneCollector() {
     }
 
     while (!hasUnoccupiedWorker()) {
+        if (_workerPopulation + _incomingWorkers > 0) {
+            skipQuietTimesteps(quietTimesteps().value_or(0));
+        }
         advanceTime();
         if (_workerPopulation + _incomingWorkers <= 0) {
             return;
         }
     }
 
-    if (hasUnoccupiedGeyser()) {
+    if (hasUnoccupiedGeyser() && canQueueBuilding()) {
         _minerals -= buildVespeneCollectorCost.minerals;
         _vespene -= buildVespeneCollectorCost.vespene;
         _incomingVespeneCollectors++;
 
-        _occupiedWorkerTimers.emplace_back(buildVespeneCollectorCost.buildTime);
-        _constructions.emplace_back(
-            buildVespeneCollectorCost.buildTime,
-            shared_from_this(),
-            &State::addVespeneCollector);
+        occupyWorker(buildVespeneCollectorCost.buildTime, Action::buildVespeneCollector);
+        queueConstruction(buildVespeneCollectorCost.buildTime, Action::buildVespeneCollector);
     }
 }
 
 void Sc2::State::buildBase() {
     while (!canAffordConstruction(buildBaseCost)) {
+        skipQuietTimestepsUntilAffordable(buildBaseCost);
         const auto initialMineral = _minerals;
         advanceTime();
         if (initialMineral == _minerals) {
@@ -571,22 +910,30 @@ void Sc2::State::buildBase() {
     }
 
     while (!hasUnoccupiedWorker()) {
+        if (_workerPopulation + _incomingWorkers > 0) {
+            skipQuietTimesteps(quietTimesteps().value_or(0));
+        }
         advanceTime();
         if (_workerPopulation + _incomingWorkers <= 0) {
             return;
         }
     }
 
+    if (!canQueueBuilding()) {
+        return;
+    }
+
     _minerals -= buildBaseCost.minerals;
     _vespene -= buildBaseCost.vespene;
 
     _incomingBases++;
-    _occupiedWorkerTimers.emplace_back(buildBaseCost.buildTime);
-    _constructions.emplace_back(buildBaseCost.buildTime, shared_from_this(), &State::addBase);
+    occupyWorker(buildBaseCost.buildTime, Action::buildBase);
+    queueConstruction(buildBaseCost.buildTime, Action::buildBase);
 }
 
 void Sc2::State::buildWorker() {
     while (!canAffordConstruction(buildWorkerCost)) {
+        skipQuietTimestepsUntilAffordable(buildWorkerCost);
         const auto initialMineral = _minerals;
         advanceTime();
         if (initialMineral == _minerals) {
@@ -595,24 +942,27 @@ void Sc2::State::buildWorker() {
     }
 
     while (!hasFreeBase()) {
+        if (!(_bases.empty() && _workerPopulation == 0)) {
+            skipQuietTimesteps(std::min(quietTimesteps().value_or(0), _endTime - _currentTime - 1));
+        }
         advanceTime();
         if ((_bases.empty() && _workerPopulation == 0) || endTimeReached()) {
             return;
         }
     }
 
-    if (!populationLimitReached()) {
+    if (!populationLimitReached() && canQueueConstruction()) {
         _minerals -= buildWorkerCost.minerals;
         _vespene -= buildWorkerCost.vespene;
         _incomingWorkers += 1;
 
-        auto c = Construction(this->buildWorkerCost.buildTime, shared_from_this(), &State::addWorker);
-        _constructions.emplace_back(c);
+        queueConstruction(buildWorkerCost.buildTime, Action::buildWorker);
     }
 }
 
 void Sc2::State::buildHouse() {
     while (!canAffordConstruction(buildHouseCost)) {
+        skipQuietTimestepsUntilAffordable(buildHouseCost);
         const auto initialMineral = _minerals;
         advanceTime();
         if (initialMineral == _minerals) {
@@ -621,18 +971,24 @@ void Sc2::State::buildHouse() {
     }
 
     while (!hasUnoccupiedWorker()) {
+        if (_workerPopulation + _incomingWorkers > 0) {
+            skipQuietTimesteps(quietTimesteps().value_or(0));
+        }
         advanceTime();
         if (_workerPopulation + _incomingWorkers <= 0) {
             return;
         }
     }
 
+    if (!canQueueBuilding()) {
+        return;
+    }
 
     _minerals -= buildHouseCost.minerals;
     _vespene -= buildHouseCost.vespene;
     _incomingHouse = true;
-    _occupiedWorkerTimers.emplace_back(buildHouseCost.buildTime);
-    _constructions.emplace_back(buildHouseCost.buildTime, shared_from_this(), &State::addHouse);
+    occupyWorker(buildHouseCost.buildTime, Action::buildHouse);
+    queueConstruction(buildHouseCost.buildTime, Action::buildHouse);
 }
 
 // void Sc2::State::setBiases(const std::shared_ptr<std::map<int, std::tuple<double, double> > > &combatBiases) {
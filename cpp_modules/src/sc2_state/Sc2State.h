@@ -1,14 +1,21 @@
 #pragma once
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
-#include <list>
 #include <map>
+#include <memory>
+#include <optional>
 #include <random>
+#include <span>
+#include <type_traits>
 #include <vector>
 #include <sstream>
 
 #include "Base.h"
 #include "Construction.h"
+#include "StaticVector.h"
+#include "TimerQueue.h"
+#include "Rng.h"
 #include "ActionEnum.h"
 #include "UnitPower.h"
 #include "Enemy.h"
@@ -26,12 +33,12 @@ namespace Sc2 {
 		const int incomingTanks = 0;
 		const int incomingVikings = 0;
 		const int populationLimit = 0;
-		std::vector<Base> &bases;
+		std::span<const Base> bases = {};
 		const int barracksAmount = 0;
 		const int factoryAmount = 0;
 		const int starPortAmount = 0;
-		std::list<Construction> &constructions;
-		std::vector<int> &occupiedWorkerTimers;
+		std::span<const Construction> constructions = {};
+		std::span<const int> occupiedWorkerTimers = {};
 		const int currentTime = 0;
 		const int endTime = 0;
 		const bool hasHouse = false;
@@ -40,7 +47,7 @@ namespace Sc2 {
 		const int incomingFactory = 0;
 		const int incomingBases = 0;
 		const int maxBases = 0;
-		Enemy enemy;
+		Enemy enemy = {};
 	};
 
 	enum class ArmyValueFunction {
@@ -75,15 +82,63 @@ namespace Sc2 {
 		return os;
 	}
 
-	class State : public std::enable_shared_from_this<State> {
+	struct ActionCost {
+		int minerals;
+		int vespene;
+		int buildTime;
+
+		constexpr ActionCost(const int minerals, const int vespene, const int buildTime): minerals(minerals),
+			vespene(vespene),
+			buildTime(buildTime) {
+		}
+	};
+
+	// How far apart two states can be and still be treated as the same, e.g. to reuse the search of one for the other
+	struct StateTolerance {
+		// Minerals and vespene
+		int resources = 25;
+		// The current time and the time left on each construction and occupied worker
+		int timers = 5;
+		// The ground and air power of the enemy
+		int enemyPower = 10;
+	};
+
+	class State {
+	public:
+		// The combat success and end probabilities of a state, which are always needed together
+		struct Evaluation {
+			double combatSuccess;
+			double end;
+		};
+
+		static constexpr int END_PROBABILITY_FUNCTIONS = 3;
+
+	private:
+		using CombatSuccessFunction = double (*)(const State &);
+		using EvaluationFunction = Evaluation (*)(const State &);
+
 		ArmyValueFunction _armyValueFunction;
 		int END_PROBABILITY_FUNCTION;
+		// Specialisations for the army value and end probability functions, selected whenever either is set
+		CombatSuccessFunction _combatSuccessFunction = nullptr;
+		EvaluationFunction _evaluationFunction = nullptr;
+
+		void selectEvaluation();
+
+		template<ArmyValueFunction Function>
+		static double combatSuccessProbability(const State &state);
+		template<int Function>
+		static double endProbability(double combatSuccess);
+		template<ArmyValueFunction ArmyFunction, int EndFunction>
+		static Evaluation evaluate(const State &state);
+		static double unsupportedCombatSuccess(const State &state);
+		static Evaluation unsupportedEvaluation(const State &state);
 
 
 		int _minerals = 50;
 		int _vespene = 0;
 		int _workerPopulation = 12;
-		const int MAX_SCOUT_POPULATION = 1;
+		static constexpr int MAX_SCOUT_POPULATION = 1;
 		int _marinePopulation = 0;
 		int _tankPopulation = 0;
 		int _vikingPopulation = 0;
@@ -92,16 +147,17 @@ namespace Sc2 {
 		int _incomingTanks = 0;
 		int _incomingVikings = 0;
 		int _incomingVespeneCollectors = 0;
-		const int MAX_POPULATION_LIMIT = 200;
+		static constexpr int MAX_POPULATION_LIMIT = 200;
 		const int MAX_BASES = 17;
 		int _populationLimit = 15;
 		int _barracksAmount = 0;
 		int _factoryAmount = 0;
 		int _starPortAmount = 0;
-		std::vector<Base> _bases = std::vector{Base()};
-		std::list<Construction> _constructions{};
-		std::vector<int> _occupiedWorkerTimers{};
-		std::mt19937 _rng;
+		StaticVector<Base, MAX_BASES_CAPACITY> _bases = {Base()};
+		// Both queues hold the action that queued the timer, keyed on the absolute time it completes at
+		TimerQueue<Action, MAX_CONSTRUCTIONS> _constructions{};
+		TimerQueue<Action, MAX_OCCUPIED_WORKERS> _occupiedWorkerTimers{};
+		Rng _rng;
 
 		Enemy _enemy;
 
@@ -116,49 +172,56 @@ namespace Sc2 {
 		int _incomingFactory = 0;
 		int _incomingBases = 0;
 
-		struct ActionCost {
-			int minerals;
-			int vespene;
-			int buildTime;
-
-			ActionCost(const int minerals, const int vespene, const int buildTime): minerals(minerals),
-				vespene(vespene),
-				buildTime(buildTime) {
-			}
-		};
-
-		ActionCost buildWorkerCost = ActionCost(50, 0, 12);
-		ActionCost buildBaseCost = ActionCost(400, 0, 71);
-		ActionCost buildHouseCost = ActionCost(100, 0, 21);
-		ActionCost buildVespeneCollectorCost = ActionCost(75, 0, 21);
-		ActionCost buildMarineCost = ActionCost(50, 0, 18);
-		ActionCost buildBarracksCost = ActionCost(150, 0, 46);
-		ActionCost buildFactoryCost = ActionCost(200, 125, 61);
-		ActionCost buildStarPortCost = ActionCost(150, 100, 36);
-		ActionCost buildTankCost = ActionCost(150, 125, 32);
-		ActionCost buildVikingCost = ActionCost(150, 75, 30);
+		static constexpr ActionCost buildWorkerCost = ActionCost(50, 0, 12);
+		static constexpr ActionCost buildBaseCost = ActionCost(400, 0, 71);
+		static constexpr ActionCost buildHouseCost = ActionCost(100, 0, 21);
+		static constexpr ActionCost buildVespeneCollectorCost = ActionCost(75, 0, 21);
+		static constexpr ActionCost buildMarineCost = ActionCost(50, 0, 18);
+		static constexpr ActionCost buildBarracksCost = ActionCost(150, 0, 46);
+		static constexpr ActionCost buildFactoryCost = ActionCost(200, 125, 61);
+		static constexpr ActionCost buildStarPortCost = ActionCost(150, 100, 36);
+		static constexpr ActionCost buildTankCost = ActionCost(150, 125, 32);
+		static constexpr ActionCost buildVikingCost = ActionCost(150, 75, 30);
 
 		void advanceConstructions();
+		void completeConstruction(Action action);
 		void advanceResources();
 		void advanceOccupiedWorkers();
 		void advanceEnemyAction();
 		void advanceTime();
 
+		// Timesteps that pass before a construction or an occupied worker completes, in which only time, resources
+		// and the enemy change. Zero while some of them are paused, empty while none are queued.
+		std::optional<int> quietTimesteps() const;
+		// Jumps over at most `limit` quiet timesteps at once, with the same outcome as advancing them one by one
+		void skipQuietTimesteps(int limit);
+		// Skips the quiet timesteps before the one in which the action becomes affordable at the current income
+		void skipQuietTimestepsUntilAffordable(const ActionCost &actionCost);
+
 		bool hasEnoughMinerals(const int cost) const { return _minerals >= cost; };
 		bool hasEnoughVespene(const int cost) const { return _vespene >= cost; }
 		bool hasUnoccupiedWorker() const { return _workerPopulation - _occupiedWorkerTimers.size() > 0; }
+		// The inline queues have a fixed capacity, a full queue is treated like any other unmet requirement
+		bool canQueueConstruction() const { return !_constructions.full(); }
+		bool canQueueBuilding() const { return !_constructions.full() && !_occupiedWorkerTimers.full(); }
 
-		void occupyWorker(int time) {
-			_occupiedWorkerTimers.emplace_back(time);
+		void occupyWorker(const int time, const Action action) {
+			_occupiedWorkerTimers.push(_currentTime + time, action);
 		};
 
+		void queueConstruction(const int buildTime, const Action action) {
+			_constructions.push(_currentTime + buildTime, action);
+		}
+
 		void addVespeneCollector();
 
 		void addBase() {
 			_populationLimit += 15;
 			_incomingBases--;
 			_populationLimit = _populationLimit >= MAX_POPULATION_LIMIT ? MAX_POPULATION_LIMIT : _populationLimit;
-			_bases.emplace_back();
+			if (!_bases.full()) {
+				_bases.emplace_back();
+			}
 		}
 
 		void addWorker() {
@@ -246,8 +309,8 @@ namespace Sc2 {
 		[[nodiscard]] int getOccupiedPopulation() const { return static_cast<int>(_occupiedWorkerTimers.size()); }
 		[[nodiscard]] int getEnemyCombatUnits() const { return _enemy.enemyCombatUnits; }
 		[[nodiscard]] Enemy getEnemy() { return _enemy; }
-		[[nodiscard]] std::list<Construction> getConstructions() const { return _constructions; }
-		[[nodiscard]] std::vector<Base> getBases() const { return _bases; }
+		[[nodiscard]] std::vector<Construction> getConstructions() const;
+		[[nodiscard]] const StaticVector<Base, MAX_BASES_CAPACITY> &getBases() const { return _bases; }
 		[[nodiscard]] int getBarracksAmount() const { return _barracksAmount; }
 		[[nodiscard]] int getFactoryAmount() const { return _factoryAmount; }
 		[[nodiscard]] int getStarPortAmount() const { return _starPortAmount; }
@@ -348,87 +411,45 @@ namespace Sc2 {
 		std::vector<Action> getLegalActions() const;
 
 
-		double getValueMarines() const {
-			return softmax(std::vector{
-				               static_cast<double>(_marinePopulation) / 4, static_cast<double>(_enemy.enemyCombatUnits) / 4
-			               }, 0);
-		}
-
-		double getValueArmyPowerScaled() const {
-			//this assumes the vikings can attack both air and ground at the same time
-			auto airPower = calculateAirPower();
-			auto groundPower = calculateGroundPower();
-			auto groundSoftMax = softmax(std::vector{
-				                             static_cast<double>(groundPower) / 4,
-				                             static_cast<double>(_enemy.groundPower) / 4
-			                             }, 0);
-			auto airSoftMax = softmax(std::vector{
-				                          static_cast<double>(airPower) / 4, static_cast<double>(_enemy.airPower) / 4
-			                          }, 0);
-			auto average = (airSoftMax + groundSoftMax) / 2;
-			auto difference = std::abs(airSoftMax - groundSoftMax);
-			return average * (1 - difference);
-		}
-
-		double getValueArmyPowerAverage() const {
-			//this assumes the vikings can attack both air and ground at the same time
-			auto airPower = calculateAirPower();
-			auto groundPower = calculateGroundPower();
-			auto groundSoftMax = softmax(std::vector{
-				                             static_cast<double>(groundPower) / 4,
-				                             static_cast<double>(_enemy.groundPower) / 4
-			                             }, 0);
-			auto airSoftMax = softmax(std::vector{
-				                          static_cast<double>(airPower) / 4, static_cast<double>(_enemy.airPower) / 4
-			                          }, 0);
-			auto average = (airSoftMax + groundSoftMax) / 2;
-			return average;
-		}
-
-		double getValueMinArmyPower() const {
-			auto airPower = calculateAirPower();
-			auto groundPower = calculateGroundPower();
-			auto groundSoftMax = softmax(std::vector{
-				                             static_cast<double>(groundPower) / 4,
-				                             static_cast<double>(_enemy.groundPower) / 4
-			                             }, 0);
-			auto airSoftMax = softmax(std::vector{
-				                          static_cast<double>(airPower) / 4, static_cast<double>(_enemy.airPower) / 4
-			                          }, 0);
-			return std::min(groundSoftMax, airSoftMax);
-		}
-
 		int calculateGroundPower() const {
-			return _marinePopulation * unitGroundPower.at(UnitType::Marine) +
-			       _tankPopulation * unitGroundPower.at(UnitType::Tank) +
-			       _vikingPopulation * unitGroundPower.at(UnitType::Viking);
+			return _marinePopulation * unitGroundPower[UnitType::Marine] +
+			       _tankPopulation * unitGroundPower[UnitType::Tank] +
+			       _vikingPopulation * unitGroundPower[UnitType::Viking];
 		}
 
 		int calculateAirPower() const {
-			return _marinePopulation * unitAirPower.at(UnitType::Marine) +
-			       _tankPopulation * unitAirPower.at(UnitType::Tank) +
-			       _vikingPopulation * unitAirPower.at(UnitType::Viking);
+			return _marinePopulation * unitAirPower[UnitType::Marine] +
+			       _tankPopulation * unitAirPower[UnitType::Tank] +
+			       _vikingPopulation * unitAirPower[UnitType::Viking];
 		}
 
 		double getValue() const {
 			return getCombatSuccessProbability();
 		}
 
-		std::tuple<double, double, double> getWinProbabilities();
+		Evaluation evaluate() const { return _evaluationFunction(*this); }
+
+		static std::tuple<double, double, double> getWinProbabilities(const Evaluation &evaluation);
+		std::tuple<double, double, double> getWinProbabilities() const { return getWinProbabilities(evaluate()); }
 
-		double getCombatSuccessProbability() const;
-		double getEndProbability() const;
+		double getCombatSuccessProbability() const { return _combatSuccessFunction(*this); }
+		double getEndProbability() const { return evaluate().end; }
 		void addEnemyUnit(){_enemy.takeAction(500, EnemyAction::addEnemyUnit);}
 
-		static double softmax(std::vector<double> vector, const int index) {
-			double sum = 0;
-			for (const auto &value: vector) {
-				sum += std::exp(value);
-			}
-			return std::exp(vector.at(index)) / sum;
-		}
+		[[nodiscard]] std::vector<int> getOccupiedWorkerTimers() const;
 
-		std::vector<int> &getOccupiedWorkerTimers() { return _occupiedWorkerTimers; }
+		/*
+		 * Whether the states are the same within the tolerance. Units, buildings and what is being built have to be
+		 * the same, while resources, timers and the power of the enemy only have to be close.
+		 */
+		[[nodiscard]] bool matches(const State &other, const StateTolerance &tolerance) const;
+
+		/*
+		 * A Zobrist style hash of the players side of the state, a sum of a random key for each field and value, so
+		 * states reached by taking the same actions in another order hash the same. The enemy and the random streams
+		 * are left out, the enemy is sampled anew along every path through the search anyway.
+		 */
+		[[nodiscard]] std::uint64_t hash() const;
 
 
 		bool endTimeReached() const {
@@ -439,18 +460,34 @@ namespace Sc2 {
 			return endTimeReached() || getEndProbability() > 0.90;
 		}
 
+		// The same as GameOver, for a state that has already been evaluated
+		bool GameOver(const Evaluation &evaluation) const {
+			return endTimeReached() || evaluation.end > 0.90;
+		}
+
 		int getCurrentTime() const { return _currentTime; }
 		void resetCurrentTime() { _currentTime = 0; }
 
 		void setEndProbabilityFunction(const int endProbabilityFunction) {
 			END_PROBABILITY_FUNCTION = endProbabilityFunction;
+			selectEvaluation();
 		}
 
 		void setArmyValueFunction(const ArmyValueFunction army_value_function) {
 			_armyValueFunction = army_value_function;
+			selectEvaluation();
 		};
 		static std::shared_ptr<State> DeepCopy(const State &state, bool onRollout = false);
 
+		// Gives a copied state random streams of its own, split off from the parent's, so sibling states in the
+		// search tree do not share the enemy's future actions
+		void splitRandomStreams(State &parent) { splitRandomStreams(parent._rng); }
+		// Gives the state random streams split off from the generator, e.g. for a fresh sample of the enemy
+		void splitRandomStreams(Rng &source) {
+			_rng = source.split();
+			_enemy.setRng(_rng.split());
+		}
+
 		static std::shared_ptr<State> StateBuilder(const int minerals,
 		                                           const int vespene,
 		                                           const int workerPopulation,
@@ -462,12 +499,12 @@ namespace Sc2 {
 		                                           const int incomingTanks,
 		                                           const int incomingVikings,
 		                                           const int populationLimit,
-		                                           std::vector<Base> &bases,
+		                                           const std::vector<Base> &bases,
 		                                           const int barracksAmount,
 		                                           const int factoryAmount,
 		                                           const int starPortAmount,
-		                                           std::list<Construction> &constructions,
-		                                           std::vector<int> &occupiedWorkerTimers,
+		                                           const std::vector<Construction> &constructions,
+		                                           const std::vector<int> &occupiedWorkerTimers,
 		                                           const int currentTime,
 		                                           const int endTime,
 		                                           const bool hasHouse,
@@ -518,14 +555,7 @@ namespace Sc2 {
 												  		   const unsigned int endProbabilityFunction,
 														   const ArmyValueFunction armyValueFunction,
 		                                                   unsigned int seed) {
-			auto state = std::make_shared<State>(params,endProbabilityFunction, armyValueFunction ,seed);
-
-			for (auto &construction: params.constructions) {
-				construction.setState(state);
-				state->_constructions.emplace_back(construction);
-			}
-
-			return state;
+			return std::make_shared<State>(params,endProbabilityFunction, armyValueFunction ,seed);
 		};
 
 		State(const StateBuilderParams &params, const int endProbabilityFunction, const ArmyValueFunction armyValueFunction,const unsigned int seed):
@@ -546,10 +576,6 @@ namespace Sc2 {
 		                     _barracksAmount(params.barracksAmount),
 		                     _factoryAmount(params.factoryAmount),
 		                     _starPortAmount(params.starPortAmount),
-		                     _bases(std::move(params.bases)),
-		                     _constructions(std::list<Construction>()),
-		                     _occupiedWorkerTimers(
-			                     std::move(params.occupiedWorkerTimers)),
 		                     _enemy(params.enemy),
 		                     _endTime(params.endTime),
 		                     _currentTime(params.currentTime),
@@ -558,66 +584,39 @@ namespace Sc2 {
 		                     _incomingBarracks(params.incomingBarracks),
 							 _incomingFactory(params.incomingFactory),
 							 _incomingBases(params.incomingBases){
-			_rng = std::mt19937(seed);
+			if (params.bases.size() > _bases.capacity() ||
+			    params.constructions.size() > _constructions.capacity() ||
+			    params.occupiedWorkerTimers.size() > _occupiedWorkerTimers.capacity()) {
+				throw std::length_error("State exceeds the capacity for bases, constructions or occupied workers");
+			}
+			_bases.clear();
+			for (const auto &base: params.bases) {
+				_bases.push_back(base);
+			}
+			for (const auto &construction: params.constructions) {
+				queueConstruction(construction.getTimeLeft(), construction.getAction());
+			}
+			for (const auto &timer: params.occupiedWorkerTimers) {
+				occupyWorker(timer, Action::none);
+			}
+			_rng = Rng(seed);
+			selectEvaluation();
 		};
 
-		State(const State &state) :
-				enable_shared_from_this(state),
-				_armyValueFunction(state._armyValueFunction),
-				END_PROBABILITY_FUNCTION(state.END_PROBABILITY_FUNCTION),
-				MAX_BASES(state.MAX_BASES),
-			    _endTime(state._endTime),
-				_currentTime(state._currentTime) {
-			_minerals = state._minerals;
-			_vespene = state._vespene;
-			_workerPopulation = state._workerPopulation;
-			_marinePopulation = state._marinePopulation;
-			_tankPopulation = state._tankPopulation;
-			_vikingPopulation = state._vikingPopulation;
-			_incomingWorkers = state._incomingWorkers;
-			_incomingMarines = state._incomingMarines;
-			_incomingTanks = state._incomingTanks;
-			_incomingVikings = state._incomingVikings;
-			_populationLimit = state._populationLimit;
-			_incomingVespeneCollectors = state._incomingVespeneCollectors;
-			_barracksAmount = state._barracksAmount;
-			_factoryAmount = state._factoryAmount;
-			_starPortAmount = state._starPortAmount;
-
-			buildWorkerCost = state.buildWorkerCost;
-			buildBaseCost = state.buildBaseCost;
-			buildHouseCost = state.buildHouseCost;
-			buildVespeneCollectorCost = state.buildVespeneCollectorCost;
-			buildMarineCost = state.buildMarineCost;
-			buildBarracksCost = state.buildBarracksCost;
-			buildFactoryCost = state.buildFactoryCost;
-			buildStarPortCost = state.buildStarPortCost;
-			buildTankCost = state.buildTankCost;
-			buildVikingCost = state.buildVikingCost;
-
-			_bases = std::vector<Base>();
-			_constructions = std::list<Construction>();
-			_occupiedWorkerTimers = state._occupiedWorkerTimers;
-
-			_enemy = state._enemy;
-
-			_rng = state._rng;
-
-			_hasHouse = state._hasHouse;
-			_incomingHouse = state._incomingHouse;
-			_incomingBarracks = state._incomingBarracks;
-			_incomingFactory = state._incomingFactory;
-			_incomingBases = state._incomingBases;
-		};
+		// Every member is stored inline, so a copy is a plain memberwise copy without any allocations
+		State(const State &state) = default;
 
 		explicit State(const int endTime, const int endProbabilityFunction, const ArmyValueFunction armyValueFunction ,const unsigned int seed):
 					_armyValueFunction(armyValueFunction),
 					END_PROBABILITY_FUNCTION(endProbabilityFunction),
 					_endTime(endTime) {
-			_rng = std::mt19937(seed);
+			_rng = Rng(seed);
+			_enemy.setRng(_rng.split());
+			selectEvaluation();
 		}
 
-		State(): _armyValueFunction(ArmyValueFunction::MinPower), END_PROBABILITY_FUNCTION(2), _rng(std::mt19937(std::random_device{}())), _endTime(1000) {
+		State(): _armyValueFunction(ArmyValueFunction::MinPower), END_PROBABILITY_FUNCTION(2), _rng(Rng(std::random_device{}())), _endTime(1000) {
+			selectEvaluation();
 		}
 
 		std::string toString() const {
@@ -646,10 +645,10 @@ namespace Sc2 {
 
 			return str.str();
 		}
-
-		friend Construction;
 	};
 
+	static_assert(std::is_trivially_copyable_v<State>, "Copying a State should not allocate");
+
 	inline std::ostream &operator<<(std::ostream &os, const State &state) {
 		os << state.toString();
 		return os;
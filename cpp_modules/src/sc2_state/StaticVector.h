@@ -0,0 +1,87 @@
+#ifndef STATICVECTOR_H
+#define STATICVECTOR_H
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace Sc2 {
+	/*
+	 * A vector with a fixed capacity that keeps its elements inline.
+	 * It is trivially copyable as long as T is, which lets a State be copied with a single memcpy.
+	 */
+	template<typename T, std::size_t Capacity>
+	class StaticVector {
+		static_assert(std::is_trivially_copyable_v<T>, "StaticVector only holds trivially copyable types");
+
+		std::array<T, Capacity> _items{};
+		std::size_t _size = 0;
+
+	public:
+		using value_type = T;
+		using size_type = std::size_t;
+		using iterator = T *;
+		using const_iterator = const T *;
+
+		StaticVector() = default;
+
+		StaticVector(std::initializer_list<T> items) {
+			for (const auto &item: items) {
+				push_back(item);
+			}
+		}
+
+		[[nodiscard]] size_type size() const { return _size; }
+		[[nodiscard]] static constexpr size_type capacity() { return Capacity; }
+		[[nodiscard]] bool empty() const { return _size == 0; }
+		[[nodiscard]] bool full() const { return _size == Capacity; }
+
+		iterator begin() { return _items.data(); }
+		iterator end() { return _items.data() + _size; }
+		const_iterator begin() const { return _items.data(); }
+		const_iterator end() const { return _items.data() + _size; }
+
+		T *data() { return _items.data(); }
+		const T *data() const { return _items.data(); }
+
+		T &operator[](const size_type index) { return _items[index]; }
+		const T &operator[](const size_type index) const { return _items[index]; }
+
+		T &front() { return _items[0]; }
+		const T &front() const { return _items[0]; }
+		T &back() { return _items[_size - 1]; }
+		const T &back() const { return _items[_size - 1]; }
+
+		void push_back(const T &item) {
+			if (full()) {
+				throw std::length_error("StaticVector capacity exceeded");
+			}
+			_items[_size++] = item;
+		}
+
+		template<typename... Args>
+		T &emplace_back(Args &&... args) {
+			if (full()) {
+				throw std::length_error("StaticVector capacity exceeded");
+			}
+			_items[_size] = T(std::forward<Args>(args)...);
+			return _items[_size++];
+		}
+
+		void pop_back() { --_size; }
+
+		iterator erase(iterator position) {
+			for (auto it = position; it + 1 != end(); ++it) {
+				*it = *(it + 1);
+			}
+			--_size;
+			return position;
+		}
+
+		void clear() { _size = 0; }
+	};
+}
+
+#endif //STATICVECTOR_H
@@ -0,0 +1,128 @@
+#ifndef TIMERQUEUE_H
+#define TIMERQUEUE_H
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "StaticVector.h"
+
+namespace Sc2 {
+	/*
+	 * A fixed capacity min-heap of timers keyed on the absolute time they complete at.
+	 * Every timer also gets a sequence number, so the queue still knows the order the timers were added in.
+	 * Advancing a timestep only touches the timers that complete, unless some timers have to be paused.
+	 */
+	template<typename T, std::size_t Capacity>
+	class TimerQueue {
+	public:
+		struct Timer {
+			int completionTime = 0;
+			std::uint32_t sequence = 0;
+			T value{};
+		};
+
+		using size_type = std::size_t;
+
+	private:
+		StaticVector<Timer, Capacity> _heap{};
+		std::uint32_t _nextSequence = 0;
+
+		static bool completesLater(const Timer &left, const Timer &right) {
+			if (left.completionTime != right.completionTime) {
+				return left.completionTime > right.completionTime;
+			}
+			return left.sequence > right.sequence;
+		}
+
+		static bool addedBefore(const Timer &left, const Timer &right) {
+			return left.sequence < right.sequence;
+		}
+
+		/*
+		 * Used when some timers are paused: walks every timer in the order they were added,
+		 * postpones the paused ones by a timestep and rebuilds the heap.
+		 */
+		template<typename F>
+		void advanceWithPaused(const int currentTime, const size_type firstAdvanced, const size_type advanced,
+		                       F &&onComplete) {
+			StaticVector<Timer, Capacity> ordered = _heap;
+			std::sort(ordered.begin(), ordered.end(), addedBefore);
+
+			StaticVector<Timer, Capacity> completed{};
+			_heap.clear();
+			for (size_type i = 0; i < ordered.size(); i++) {
+				auto timer = ordered[i];
+				if (i < firstAdvanced || i >= firstAdvanced + advanced) {
+					timer.completionTime++;
+					_heap.push_back(timer);
+				} else if (timer.completionTime <= currentTime) {
+					completed.push_back(timer);
+				} else {
+					_heap.push_back(timer);
+				}
+			}
+			std::make_heap(_heap.begin(), _heap.end(), completesLater);
+
+			for (const auto &timer: completed) {
+				onComplete(timer.value);
+			}
+		}
+
+	public:
+		[[nodiscard]] size_type size() const { return _heap.size(); }
+		[[nodiscard]] static constexpr size_type capacity() { return Capacity; }
+		[[nodiscard]] bool empty() const { return _heap.empty(); }
+		[[nodiscard]] bool full() const { return _heap.full(); }
+		// The earliest completion time, the queue must not be empty
+		[[nodiscard]] int nextCompletionTime() const { return _heap.front().completionTime; }
+
+		void push(const int completionTime, const T &value) {
+			_heap.push_back({completionTime, _nextSequence++, value});
+			std::push_heap(_heap.begin(), _heap.end(), completesLater);
+		}
+
+		/*
+		 * Advances the timers at positions [firstAdvanced, firstAdvanced + advanced) in the order they were added,
+		 * calling onComplete in that order for each of them due at currentTime. Every other timer is paused,
+		 * which pushes its completion time back by one timestep.
+		 */
+		template<typename F>
+		void advance(const int currentTime, const size_type firstAdvanced, const size_type advanced, F &&onComplete) {
+			if (_heap.empty()) {
+				return;
+			}
+			if (firstAdvanced > 0 || advanced < _heap.size()) {
+				advanceWithPaused(currentTime, firstAdvanced, advanced, onComplete);
+				return;
+			}
+			if (_heap.front().completionTime > currentTime) {
+				return;
+			}
+
+			StaticVector<Timer, Capacity> completed{};
+			while (!_heap.empty() && _heap.front().completionTime <= currentTime) {
+				std::pop_heap(_heap.begin(), _heap.end(), completesLater);
+				completed.push_back(_heap.back());
+				_heap.pop_back();
+			}
+			std::sort(completed.begin(), completed.end(), addedBefore);
+			for (const auto &timer: completed) {
+				onComplete(timer.value);
+			}
+		}
+
+		// The timers in no particular order, without copying them
+		[[nodiscard]] auto begin() const { return _heap.begin(); }
+		[[nodiscard]] auto end() const { return _heap.end(); }
+
+		// The timers in the order they were added
+		[[nodiscard]] std::vector<Timer> inOrder() const {
+			std::vector<Timer> ordered(_heap.begin(), _heap.end());
+			std::sort(ordered.begin(), ordered.end(), addedBefore);
+			return ordered;
+		}
+	};
+}
+
+#endif //TIMERQUEUE_H
@@ -4,7 +4,7 @@
 
 #ifndef UNITPOWER_H
 #define UNITPOWER_H
-#include <map>
+#include "EnumArray.h"
 
 enum class UnitType {
 	Marine,
@@ -12,16 +12,11 @@ enum class UnitType {
 	Viking,
 };
 
-static const std::map<UnitType, int> unitGroundPower = {
-	{UnitType::Marine, 1},
-	{UnitType::Tank, 10},
-	{UnitType::Viking, 2}
-};
+constexpr std::size_t UNIT_TYPES = 3;
 
-static const std::map<UnitType, int> unitAirPower = {
-	{UnitType::Marine, 1},
-	{UnitType::Tank, 0},
-	{UnitType::Viking, 10}
-};
+// Indexed by UnitType: Marine, Tank, Viking
+static constexpr Sc2::EnumArray<UnitType, int, UNIT_TYPES> unitGroundPower = {{1, 10, 2}};
+
+static constexpr Sc2::EnumArray<UnitType, int, UNIT_TYPES> unitAirPower = {{1, 0, 10}};
 
 #endif //UNITPOWER_H
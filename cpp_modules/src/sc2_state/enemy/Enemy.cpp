@@ -3,9 +3,11 @@
 //
 #include "Enemy.h"
 
+#include <algorithm>
+#include <array>
 #include <iostream>
 
-Sc2::EnemyAction Sc2::Enemy::generateEnemyAction() {
+namespace {
     // Over the span of 60 seconds we assume that the enemy:
     // Specifies how many enemy units will be built
     constexpr double buildUnitAction = 8;
@@ -23,27 +25,202 @@ Sc2::EnemyAction Sc2::Enemy::generateEnemyAction() {
     constexpr double noneAction = 60 - buildUnitAction - attackAction - groundPowerIncrease - airPowerIncrease -
                                   groundProductionIncrease - airProductionIncrease;
 
-    const auto actionWeights = {
+    constexpr std::size_t ENEMY_ACTION_COUNT = 7;
+
+    constexpr std::array<Sc2::EnemyAction, ENEMY_ACTION_COUNT> enemyActions = {
+        Sc2::EnemyAction::none, Sc2::EnemyAction::addEnemyUnit, Sc2::EnemyAction::attackPlayer,
+        Sc2::EnemyAction::addEnemyGroundPower, Sc2::EnemyAction::addEnemyAirPower,
+        Sc2::EnemyAction::addEnemyGroundProduction, Sc2::EnemyAction::addEnemyAirProduction
+    };
+
+    constexpr std::size_t actionIndex(const Sc2::EnemyAction action) {
+        std::size_t index = 0;
+        while (enemyActions[index] != action) {
+            index++;
+        }
+        return index;
+    }
+
+    constexpr std::array<double, ENEMY_ACTION_COUNT> enemyActionWeights = {
         noneAction, buildUnitAction, attackAction, groundPowerIncrease, airPowerIncrease,
         groundProductionIncrease, airProductionIncrease
     };
-    std::discrete_distribution<int> dist(actionWeights.begin(), actionWeights.end());
-    // 0: None, 1: Build unit, 2: Attack, 3: GroundPowerIncrease, 4: AirPowerIncrease, 5: Ground Production, 6: Air Production
-    switch (dist(_rng)) {
-        case 1:
-            return EnemyAction::addEnemyUnit;
-        case 2:
-            return EnemyAction::attackPlayer;
-        case 3:
-            return EnemyAction::addEnemyGroundPower;
-        case 4:
-            return EnemyAction::addEnemyAirPower;
-        case 5:
-            return EnemyAction::addEnemyGroundProduction;
-        case 6:
-            return EnemyAction::addEnemyAirProduction;
-        default:
-            return EnemyAction::none;
+
+    /*
+     * Walker's alias table: a column is picked uniformly, then either the column itself or its alias,
+     * depending on the column's threshold out of 2^32.
+     */
+    struct AliasTable {
+        std::array<std::uint64_t, ENEMY_ACTION_COUNT> thresholds{};
+        std::array<std::size_t, ENEMY_ACTION_COUNT> aliases{};
+    };
+
+    // Vose's method for building the alias table
+    constexpr AliasTable makeAliasTable(const std::array<double, ENEMY_ACTION_COUNT> &weights) {
+        double sum = 0;
+        for (const auto weight: weights) {
+            sum += weight;
+        }
+
+        std::array<double, ENEMY_ACTION_COUNT> scaled{};
+        std::array<std::size_t, ENEMY_ACTION_COUNT> small{};
+        std::array<std::size_t, ENEMY_ACTION_COUNT> large{};
+        std::size_t smallCount = 0;
+        std::size_t largeCount = 0;
+        for (std::size_t i = 0; i < ENEMY_ACTION_COUNT; i++) {
+            scaled[i] = weights[i] * ENEMY_ACTION_COUNT / sum;
+            if (scaled[i] < 1) {
+                small[smallCount++] = i;
+            } else {
+                large[largeCount++] = i;
+            }
+        }
+
+        AliasTable table;
+        std::array<double, ENEMY_ACTION_COUNT> probabilities{};
+        for (std::size_t i = 0; i < ENEMY_ACTION_COUNT; i++) {
+            table.aliases[i] = i;
+            probabilities[i] = 1;
+        }
+        while (smallCount > 0 && largeCount > 0) {
+            const auto less = small[--smallCount];
+            const auto more = large[--largeCount];
+            probabilities[less] = scaled[less];
+            table.aliases[less] = more;
+            scaled[more] = scaled[more] + scaled[less] - 1;
+            if (scaled[more] < 1) {
+                small[smallCount++] = more;
+            } else {
+                large[largeCount++] = more;
+            }
+        }
+
+        for (std::size_t i = 0; i < ENEMY_ACTION_COUNT; i++) {
+            table.thresholds[i] = static_cast<std::uint64_t>(probabilities[i] * 4294967296.0);
+        }
+        return table;
+    }
+
+    constexpr AliasTable enemyActionTable = makeAliasTable(enemyActionWeights);
+
+    /*
+     * Out of a uniformly random order of power and production actions, how many power actions come before the
+     * production action number `production`, which is negative hypergeometric. Drawn by inversion.
+     */
+    int powerActionsBefore(Sc2::Rng &rng, const int powerActions, const int productionActions, const int production) {
+        double probability = 1;
+        for (int i = 0; i < production; i++) {
+            probability *= static_cast<double>(productionActions - i) / (powerActions + productionActions - i);
+        }
+
+        auto draw = rng.uniform();
+        int before = 0;
+        while (draw >= probability && before < powerActions) {
+            draw -= probability;
+            probability *= static_cast<double>(before + production) / (before + 1) *
+                    (powerActions - before) / (powerActions - before + productionActions - production);
+            before++;
+        }
+        return before;
+    }
+}
+
+Sc2::EnemyAction Sc2::Enemy::generateEnemyAction() {
+    // A single draw: the high half picks the column and the low half decides between it and its alias
+    const auto draw = _rng();
+    const auto column = static_cast<std::size_t>(((draw >> 32) * ENEMY_ACTION_COUNT) >> 32);
+    const auto fraction = draw & 0xffffffff;
+    const auto index = fraction < enemyActionTable.thresholds[column] ? column : enemyActionTable.aliases[column];
+
+    return enemyActions[index];
+}
+
+void Sc2::Enemy::sampleEnemyActions(const std::span<EnemyAction> actions) {
+    for (auto &action: actions) {
+        action = generateEnemyAction();
+    }
+}
+
+void Sc2::Enemy::advance(const int from, const int to) {
+    // Below this many timesteps, drawing the action of each timestep is cheaper than the binomial draws
+    constexpr int MULTINOMIAL_WINDOW = 24;
+    if (to - from < MULTINOMIAL_WINDOW) {
+        constexpr int BLOCK_SIZE = MULTINOMIAL_WINDOW;
+        std::array<EnemyAction, BLOCK_SIZE> block{};
+        const auto count = std::max(0, to - from);
+        sampleEnemyActions(std::span(block.data(), count));
+        for (int i = 0; i < count; i++) {
+            takeAction(from + 1 + i, block[i]);
+        }
+        return;
+    }
+
+    // The actions only change effect at these times, so within a segment every timestep is alike
+    int start = from + 1;
+    for (const int threshold: {90, 120, std::numeric_limits<int>::max()}) {
+        if (start > to) {
+            break;
+        }
+        if (start < threshold) {
+            const auto end = std::min(to, threshold - 1);
+            advanceSegment(start, end - start + 1);
+            start = end + 1;
+        }
+    }
+}
+
+void Sc2::Enemy::advanceSegment(const int startTime, const int timesteps) {
+    // How many of the timesteps take each action, drawn as a chain of binomials
+    std::array<int, ENEMY_ACTION_COUNT> counts{};
+    auto remaining = timesteps;
+    auto remainingWeight = 60.0;
+    for (std::size_t i = ENEMY_ACTION_COUNT - 1; i > 0 && remaining > 0; i--) {
+        const auto probability = std::min(1.0, enemyActionWeights[i] / remainingWeight);
+        counts[i] = _rng.binomial(remaining, probability);
+        remaining -= counts[i];
+        remainingWeight -= enemyActionWeights[i];
+    }
+    counts[0] = remaining;
+
+    const auto unitActions = counts[actionIndex(EnemyAction::addEnemyUnit)];
+    if (startTime >= 90) {
+        enemyCombatUnits += unitActions;
+        addGrowth(counts[actionIndex(EnemyAction::addEnemyGroundPower)],
+                  counts[actionIndex(EnemyAction::addEnemyGroundProduction)], groundPower, groundProduction);
+    }
+    if (startTime >= 120) {
+        addGrowth(counts[actionIndex(EnemyAction::addEnemyAirPower)],
+                  counts[actionIndex(EnemyAction::addEnemyAirProduction)], airPower, airProduction);
+    }
+    addUnits(unitActions);
+}
+
+void Sc2::Enemy::addGrowth(int powerActions, int productionActions, int &power, double &production) {
+    // The actions of a segment come in a uniformly random order. A power action adds the floor of the production,
+    // which only changes when a production action crosses an integer, so only how many power actions come before
+    // each crossing has to be drawn
+    while (powerActions > 0 && productionActions > 0) {
+        const auto current = std::floor(production);
+        auto next = production;
+        int untilChange = 0;
+        while (untilChange < productionActions && std::floor(next) == current) {
+            next += 0.1;
+            untilChange++;
+        }
+        if (std::floor(next) == current) {
+            break;
+        }
+
+        const auto before = powerActionsBefore(_choiceRng, powerActions, productionActions, untilChange);
+        power += before * static_cast<int>(current);
+        powerActions -= before;
+        production = next;
+        productionActions -= untilChange;
+    }
+
+    power += powerActions * static_cast<int>(std::floor(production));
+    for (; productionActions > 0; productionActions--) {
+        production += 0.1;
     }
 }
 
@@ -96,47 +273,65 @@ Sc2::EnemyAction Sc2::Enemy::takeAction(const int currentTime, std::optional<Ene
     return action.value();
 }
 
-void Sc2::Enemy::addProductionBuilding(const int currentTime) {
-    std::vector<ProductionBuildingType> availableBuildings = {};
-    for (const auto &[type, building]: productionBuildings) {
-        if (building.timeRequirement > currentTime)
-            continue;
-
-        auto requiredBuilding = building.buildingRequirement;
-        if (requiredBuilding!= ProductionBuildingType::None && productionBuildings[requiredBuilding].amount < 1 ) {
-            continue;
-        }
+void Sc2::Enemy::updateTimeUnlocks(const int currentTime) {
+    if (currentTime >= _timeUnlocksFrom && currentTime < _timeUnlocksUntil) {
+        return;
+    }
 
-        availableBuildings.emplace_back(type);
+    _timeUnlockedBuildings = 0;
+    _timeUnlocksFrom = std::numeric_limits<int>::min();
+    _timeUnlocksUntil = std::numeric_limits<int>::max();
+    for (std::size_t i = 0; i < PRODUCTION_BUILDING_TYPES; i++) {
+        const auto timeRequirement = PRODUCTION_BUILDING_CATALOG[i].timeRequirement;
+        if (timeRequirement <= currentTime) {
+            _timeUnlockedBuildings |= buildingBit(static_cast<ProductionBuildingType>(i));
+            _timeUnlocksFrom = std::max(_timeUnlocksFrom, timeRequirement);
+        } else {
+            _timeUnlocksUntil = std::min(_timeUnlocksUntil, timeRequirement);
+        }
     }
-    if (availableBuildings.empty()) {
+}
+
+void Sc2::Enemy::addProductionBuilding(const int currentTime) {
+    updateTimeUnlocks(currentTime);
+    const auto availableBuildings = productionBuildings.getRequirementsMet() & _timeUnlockedBuildings;
+    if (availableBuildings == 0) {
         return;
     }
-    const auto building = randomChoice(availableBuildings);
+    const auto building = static_cast<ProductionBuildingType>(randomBit(availableBuildings));
 
-    productionBuildings[building].amount += 0.1;
+    productionBuildings.setAmount(building, static_cast<float>(productionBuildings.getAmount(building) + 0.1));
 }
 
 void Sc2::Enemy::addUnits() {
-    std::vector<EnemyUnitType> availableUnits = {};
-    std::unordered_map<EnemyUnitType, ProductionBuildingType> unitBuildings = {};
-
-    for (auto & [buildingType,building]: productionBuildings) {
-        if (building.amount >= 1) {
-            auto productionList = building.getProductionList();
-            for (auto unit: productionList) {
-                availableUnits.emplace_back(unit);
-                unitBuildings[unit] = buildingType;
-            }
-        }
+    const auto availableUnits = productionBuildings.getProducibleUnits();
+    if (availableUnits == 0) {
+        return;
     }
+    const auto unit = static_cast<EnemyUnitType>(randomBit(availableUnits));
+    const auto buildingAmount = productionBuildings.getAmount(UNIT_PRODUCERS[unit]);
 
-    if (availableUnits.empty()) {
+    units[unit] += std::floor(buildingAmount);
+}
+
+void Sc2::Enemy::addUnits(int count) {
+    auto availableUnits = productionBuildings.getProducibleUnits();
+    if (availableUnits == 0 || count == 0) {
+        return;
+    }
+    if (count == 1) {
+        addUnits();
         return;
     }
-    const auto unit = randomChoice(availableUnits);
-    const auto building = unitBuildings[unit];
-    const auto buildingAmount = productionBuildings[building].amount;
 
-    units[unit] += std::floor(buildingAmount);
-}
\ No newline at end of file
+    // Every unit is picked uniformly, so the picks per unit are multinomial with equal probabilities
+    for (auto choices = std::popcount(availableUnits); availableUnits != 0 && count > 0; choices--) {
+        const auto unit = static_cast<EnemyUnitType>(std::countr_zero(availableUnits));
+        availableUnits &= availableUnits - 1;
+        const auto picks = choices == 1 ? count : _choiceRng.binomial(count, 1.0 / choices);
+        const auto buildingAmount = productionBuildings.getAmount(UNIT_PRODUCERS[unit]);
+
+        units[unit] += picks * static_cast<int>(std::floor(buildingAmount));
+        count -= picks;
+    }
+}
@@ -9,10 +9,17 @@
 #include <stdexcept>
 #include <string>
 #include <map>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
 #include <optional>
+#include <span>
 #include <utility>
 #include "UnitTypes.h"
 #include "ProductionBuildings.h"
+#include "Rng.h"
 namespace Sc2 {
 	enum class EnemyRace {
 		Zerg,
@@ -32,9 +39,9 @@ namespace Sc2 {
 	};
 	struct Enemy {
 		EnemyRace race = EnemyRace::Terran;
-		std::map<EnemyUnitType, int> units = {};
+		EnemyUnits units = {};
 
-		std::unordered_map<ProductionBuildingType, ProductionBuilding> productionBuildings = {};
+		ProductionBuildings productionBuildings = {};
 		int groundPower = 0;
 		double groundProduction = 1;
 		int airPower = 0;
@@ -42,21 +49,27 @@ namespace Sc2 {
 		int enemyCombatUnits = 0;
 
 		EnemyAction generateEnemyAction();
+		// Fills the span with independently sampled actions, one draw each, e.g. for a window of timesteps
+		void sampleEnemyActions(std::span<EnemyAction> actions);
 		EnemyAction takeAction(int currentTime, std::optional<EnemyAction> action = std::nullopt);
-
-		void initializeUnits() {
-			// Iterate through each value in the enum
-			for (int i = 0; i != static_cast<int>(EnemyUnitType::Last); i++ ) {
-				units[static_cast<EnemyUnitType>(i)] = 0;
-			}
+		/*
+		 * Takes the actions of every timestep after `from` up to and including `to`. Longer windows are split where
+		 * the actions change effect, at 90 and 120, and each segment draws how many timesteps take each action at
+		 * once, so the result follows the same distribution as taking the actions one timestep at a time.
+		 */
+		void advance(int from, int to);
+		// Replaces the random streams, e.g. with ones split off from another generator
+		void setRng(const Rng &rng) {
+			_rng = rng;
+			_choiceRng = _rng.split();
 		}
 
 		Enemy(const EnemyRace race,
-			  std::map<EnemyUnitType, int> units,
-			  std::unordered_map<ProductionBuildingType, ProductionBuilding> productionBuildings,
+			  const EnemyUnits &units,
+			  const ProductionBuildings &productionBuildings,
 			  const unsigned int seed)
-			: race(race), units(std::move(units)), productionBuildings(std::move(productionBuildings)) {
-			_rng = std::mt19937(seed);
+			: race(race), units(units), productionBuildings(productionBuildings) {
+			setRng(Rng(seed));
 		}
 
 
@@ -64,34 +77,33 @@ namespace Sc2 {
 		      const std::map<std::string, int> &units,
 		      const std::map<ProductionBuildingType, int> &productionBuildings)
 			: race(race), units(convertToEnum(units)), productionBuildings(convertToProductionBuildings(productionBuildings)) {
-			_rng = std::mt19937(std::random_device{}());
+			setRng(Rng(std::random_device{}()));
 		}
 
 
 		void initializeTerranBuildings() {
-			productionBuildings[ProductionBuildingType::Barracks] = BarracksProductionBuilding(0);
-			productionBuildings[ProductionBuildingType::Starport] = StarportProductionBuilding(0);
-			productionBuildings[ProductionBuildingType::Factory] = FactoryProductionBuilding(0);
+			productionBuildings.setAmount(ProductionBuildingType::Barracks, 0);
+			productionBuildings.setAmount(ProductionBuildingType::Starport, 0);
+			productionBuildings.setAmount(ProductionBuildingType::Factory, 0);
 		}
 		void initializeZergBuildings() {
-			productionBuildings[ProductionBuildingType::Hatchery] = HatcheryProductionBuilding(1);
-			productionBuildings[ProductionBuildingType::Spire] = SpireProductionBuilding(0);
-			productionBuildings[ProductionBuildingType::BanelingNest] = BanelingNestProductionBuilding(0);
-			productionBuildings[ProductionBuildingType::HydraliskDen] = HydraliskProductionBuilding(0);
-			productionBuildings[ProductionBuildingType::InfestationPit] = InfestationPitProductionBuilding(0);
-			productionBuildings[ProductionBuildingType::LurkerDen] = LurkerDenProductionBuilding(0);
-			productionBuildings[ProductionBuildingType::RoachWarren] = RoachWarrenProductionBuilding(0);
-			productionBuildings[ProductionBuildingType::SpawningPool] = SpawningPoolProductionBuilding(0);
-			productionBuildings[ProductionBuildingType::UltraliskCavern] = UltraliskCavernProductionBuilding(0);
+			productionBuildings.setAmount(ProductionBuildingType::Hatchery, 1);
+			productionBuildings.setAmount(ProductionBuildingType::Spire, 0);
+			productionBuildings.setAmount(ProductionBuildingType::BanelingNest, 0);
+			productionBuildings.setAmount(ProductionBuildingType::HydraliskDen, 0);
+			productionBuildings.setAmount(ProductionBuildingType::InfestationPit, 0);
+			productionBuildings.setAmount(ProductionBuildingType::LurkerDen, 0);
+			productionBuildings.setAmount(ProductionBuildingType::RoachWarren, 0);
+			productionBuildings.setAmount(ProductionBuildingType::SpawningPool, 0);
+			productionBuildings.setAmount(ProductionBuildingType::UltraliskCavern, 0);
 		}
 		void initializeProtossBuildings() {
-			productionBuildings[ProductionBuildingType::Gateway] = GatewayProductionBuilding(0);
-			productionBuildings[ProductionBuildingType::Stargate] = StargateProductionBuilding(0);
-			productionBuildings[ProductionBuildingType::RoboticsFacility] = RoboticsFacilityProductionBuilding(0);
+			productionBuildings.setAmount(ProductionBuildingType::Gateway, 0);
+			productionBuildings.setAmount(ProductionBuildingType::Stargate, 0);
+			productionBuildings.setAmount(ProductionBuildingType::RoboticsFacility, 0);
 		}
 
 		Enemy(const EnemyRace race, const unsigned int seed):race(race) {
-			initializeUnits();
 			switch (race) {
 				case EnemyRace::Terran:
 					initializeTerranBuildings();
@@ -103,33 +115,28 @@ namespace Sc2 {
 					initializeProtossBuildings();
 					break;
 			}
-			_rng = std::mt19937(seed);
+			setRng(Rng(seed));
 		}
 
 		Enemy(const int groundPower, const int groundProduction, const int airPower, const int airProduction)
 			: groundPower(groundPower), groundProduction(groundProduction), airPower(airPower), airProduction(airProduction) {
-			_rng = std::mt19937(std::random_device{}());
+			setRng(Rng(std::random_device{}()));
 		}
 
-		Enemy(const Enemy& enemy) {
-			_rng = enemy._rng;
-			race = enemy.race;
-			units = enemy.units;
-			enemyCombatUnits = enemy.enemyCombatUnits;
-			productionBuildings = enemy.productionBuildings;
-			groundPower = enemy.groundPower;
-			groundProduction = enemy.groundProduction;
-			airPower = enemy.airPower;
-			airProduction = enemy.airProduction;
-		}
+		// Every member is stored inline, so a copy is a plain memberwise copy without any allocations
+		Enemy(const Enemy &enemy) = default;
+		Enemy &operator=(const Enemy &enemy) = default;
 
 		Enemy() {
 			race = EnemyRace::Terran;
-			initializeUnits();
 			initializeTerranBuildings();
+			setRng(Rng());
 		}
 	private:
-		std::mt19937 _rng;
+		// Actions are drawn from _rng and the units and buildings they add from _choiceRng, so sampling a block of
+		// actions ahead of applying them draws the same numbers as sampling them one timestep at a time
+		Rng _rng;
+		Rng _choiceRng;
 
 		void addEnemyUnit() { enemyCombatUnits += 1; }
 		void addEnemyGroundPower() { groundPower += std::floor(groundProduction); }
@@ -138,25 +145,30 @@ namespace Sc2 {
 		void addEnemyAirProduction() { airProduction += 0.1; }
 		void addProductionBuilding(int currentTime);
 		void addUnits();
-
-		template<typename Container>
-		auto randomChoice(const Container &container) -> decltype(*std::begin(container)) {
-			if (container.empty()) {
-				throw std::runtime_error("Cannot select a random element from an empty container.");
+		// Adds `count` units, each picked as addUnits would pick it
+		void addUnits(int count);
+		void advanceSegment(int startTime, int timesteps);
+		void addGrowth(int powerActions, int productionActions, int &power, double &production);
+
+		// The buildings whose time requirement is met, valid for times in [_timeUnlocksFrom, _timeUnlocksUntil)
+		std::uint32_t _timeUnlockedBuildings = 0;
+		int _timeUnlocksFrom = std::numeric_limits<int>::max();
+		int _timeUnlocksUntil = std::numeric_limits<int>::min();
+		void updateTimeUnlocks(int currentTime);
+
+		// The index of a uniformly chosen set bit, the mask must not be empty
+		template<typename Mask>
+		std::size_t randomBit(Mask mask) {
+			const auto count = std::popcount(mask);
+			if (count > 1) {
+				for (auto skip = _choiceRng.below(static_cast<std::uint32_t>(count)); skip > 0; skip--) {
+					mask &= mask - 1;
+				}
 			}
-			if (container.size() == 1) {
-				return *std::begin(container);
-			}
-
-			// Get a random index
-			std::uniform_int_distribution<std::mt19937::result_type> dist(
-				0, std::distance(container.begin(), container.end()) - 1);
-
-			// Advance the iterator to the random index
-			auto it = container.begin();
-			std::advance(it, dist(_rng));
-			return *it;
+			return static_cast<std::size_t>(std::countr_zero(mask));
 		}
 	};
+
+	static_assert(std::is_trivially_copyable_v<Enemy>, "Copying an Enemy should not allocate");
 }
 #endif //ENEMY_H
@@ -4,8 +4,13 @@
 
 #ifndef PRODUCTIONBUILDINGS_H
 #define PRODUCTIONBUILDINGS_H
-#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <span>
 
+#include "EnumArray.h"
 #include "UnitTypes.h"
 
 namespace Sc2 {
@@ -28,232 +33,148 @@ namespace Sc2 {
         None,
     };
 
-    struct ProductionBuilding {
-        float amount = 0;
+    static constexpr std::size_t PRODUCTION_BUILDING_TYPES = static_cast<std::size_t>(ProductionBuildingType::None);
+    static constexpr std::size_t MAX_PRODUCTION_LIST = 6;
+
+    /*
+     * The static data of a production building type, which is the same for every enemy.
+     */
+    struct ProductionBuildingInfo {
         int timeRequirement = 0;
-        ProductionBuildingType type = ProductionBuildingType::None;
         ProductionBuildingType buildingRequirement = ProductionBuildingType::None;
+        std::array<EnemyUnitType, MAX_PRODUCTION_LIST> productionList{};
+        std::size_t productionListSize = 0;
 
-        [[nodiscard]] const std::vector<EnemyUnitType>& getProductionList() const {return productionList;}
-
-        ProductionBuilding(const ProductionBuildingType type,const float amount, const int timeRequirement,
-                           const ProductionBuildingType buildRequirement, std::vector<EnemyUnitType> const &productionList):
-            amount(amount),
-            timeRequirement(timeRequirement),
-            type(type),
-            buildingRequirement(buildRequirement),
-            productionList(productionList){}
-
-        ProductionBuilding(const ProductionBuilding& productionBuilding) {
-            amount = productionBuilding.amount;
-            productionList = productionBuilding.productionList;
-            timeRequirement = productionBuilding.timeRequirement;
-            buildingRequirement = productionBuilding.buildingRequirement;
-            type = productionBuilding.type;
-        };
+        [[nodiscard]] constexpr std::span<const EnemyUnitType> getProductionList() const {
+            return {productionList.data(), productionListSize};
+        }
+    };
 
-        ProductionBuilding() = default;
-    private:
-        std::vector<EnemyUnitType> productionList;
+    // Indexed by ProductionBuildingType
+    inline constexpr std::array<ProductionBuildingInfo, PRODUCTION_BUILDING_TYPES> PRODUCTION_BUILDING_CATALOG = {
+        ProductionBuildingInfo{130, ProductionBuildingType::None, {EnemyUnitType::MARINE, EnemyUnitType::MARAUDER, EnemyUnitType::REAPER, EnemyUnitType::GHOST}, 4}, // Barracks
+        ProductionBuildingInfo{0, ProductionBuildingType::Barracks, {EnemyUnitType::HELLION, EnemyUnitType::SIEGETANK, EnemyUnitType::THOR, EnemyUnitType::WIDOWMINE, EnemyUnitType::CYCLONE}, 5}, // Factory
+        ProductionBuildingInfo{0, ProductionBuildingType::Factory, {EnemyUnitType::VIKINGFIGHTER, EnemyUnitType::MEDIVAC, EnemyUnitType::LIBERATOR, EnemyUnitType::RAVEN, EnemyUnitType::BANSHEE, EnemyUnitType::BATTLECRUISER}, 6}, // Starport
+        ProductionBuildingInfo{0, ProductionBuildingType::SpawningPool, {EnemyUnitType::HYDRALISK}, 1}, // HydraliskDen
+        ProductionBuildingInfo{0, ProductionBuildingType::None, {}, 0}, // Hatchery
+        ProductionBuildingInfo{0, ProductionBuildingType::HydraliskDen, {EnemyUnitType::LURKERMP}, 1}, // LurkerDen
+        ProductionBuildingInfo{0, ProductionBuildingType::InfestationPit, {EnemyUnitType::ULTRALISK}, 1}, // UltraliskCavern
+        ProductionBuildingInfo{0, ProductionBuildingType::None, {EnemyUnitType::ZERGLING, EnemyUnitType::QUEEN}, 2}, // SpawningPool
+        ProductionBuildingInfo{0, ProductionBuildingType::SpawningPool, {EnemyUnitType::ROACH}, 1}, // RoachWarren
+        ProductionBuildingInfo{0, ProductionBuildingType::InfestationPit, {EnemyUnitType::MUTALISK, EnemyUnitType::CORRUPTOR, EnemyUnitType::BROODLORD}, 3}, // Spire
+        ProductionBuildingInfo{0, ProductionBuildingType::SpawningPool, {EnemyUnitType::BANELING}, 1}, // BanelingNest
+        ProductionBuildingInfo{0, ProductionBuildingType::SpawningPool, {EnemyUnitType::INFESTOR, EnemyUnitType::SWARMHOSTMP}, 2}, // InfestationPit
+        ProductionBuildingInfo{0, ProductionBuildingType::None, {EnemyUnitType::ZEALOT, EnemyUnitType::STALKER, EnemyUnitType::SENTRY, EnemyUnitType::ADEPT, EnemyUnitType::DARKTEMPLAR, EnemyUnitType::HIGHTEMPLAR}, 6}, // Gateway
+        ProductionBuildingInfo{0, ProductionBuildingType::Gateway, {EnemyUnitType::PHOENIX, EnemyUnitType::VOIDRAY, EnemyUnitType::ORACLE, EnemyUnitType::TEMPEST, EnemyUnitType::CARRIER}, 5}, // Stargate
+        ProductionBuildingInfo{0, ProductionBuildingType::Gateway, {EnemyUnitType::WARPPRISM, EnemyUnitType::OBSERVER, EnemyUnitType::IMMORTAL, EnemyUnitType::COLOSSUS, EnemyUnitType::DISRUPTOR}, 5}, // RoboticsFacility
     };
 
-    struct BarracksProductionBuilding : public ProductionBuilding {
-        explicit BarracksProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::Barracks ,
-            amount,
-            130,
-            ProductionBuildingType::None,
-            std::vector<EnemyUnitType> {EnemyUnitType::MARINE,
-                                        EnemyUnitType::MARAUDER,
-                                        EnemyUnitType::REAPER,
-                                        EnemyUnitType::GHOST
-            })
-        {
+    constexpr const ProductionBuildingInfo &productionBuildingInfo(const ProductionBuildingType type) {
+        return PRODUCTION_BUILDING_CATALOG[static_cast<std::size_t>(type)];
+    }
+
+    // The building type that produces each unit type, None for units that no building in the catalog produces
+    inline constexpr EnumArray<EnemyUnitType, ProductionBuildingType, ENEMY_UNIT_TYPES> UNIT_PRODUCERS = [] {
+        EnumArray<EnemyUnitType, ProductionBuildingType, ENEMY_UNIT_TYPES> producers{};
+        for (auto &producer: producers) {
+            producer = ProductionBuildingType::None;
         }
-    };
+        for (std::size_t i = 0; i < PRODUCTION_BUILDING_TYPES; i++) {
+            for (const auto unit: PRODUCTION_BUILDING_CATALOG[i].getProductionList()) {
+                producers[unit] = static_cast<ProductionBuildingType>(i);
+            }
+        }
+        return producers;
+    }();
 
-    struct FactoryProductionBuilding : public ProductionBuilding {
-        explicit FactoryProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::Factory ,
-            amount,
-            0,
-            ProductionBuildingType::Barracks ,
-            std::vector<EnemyUnitType> {EnemyUnitType::HELLION,
-                                        EnemyUnitType::SIEGETANK,
-                                        EnemyUnitType::THOR,
-                                        EnemyUnitType::WIDOWMINE,
-                                        EnemyUnitType::CYCLONE
-            })
-        {
+    static_assert(ENEMY_UNIT_TYPES <= 64, "Unit masks are 64 bit");
+
+    constexpr std::uint32_t buildingBit(const ProductionBuildingType type) {
+        return std::uint32_t{1} << static_cast<std::size_t>(type);
+    }
+
+    constexpr std::uint64_t unitBit(const EnemyUnitType type) {
+        return std::uint64_t{1} << static_cast<std::size_t>(type);
+    }
+
+    // The units each building type produces, as bitmasks indexed by EnemyUnitType
+    inline constexpr EnumArray<ProductionBuildingType, std::uint64_t, PRODUCTION_BUILDING_TYPES> PRODUCTION_LIST_MASKS = [] {
+        EnumArray<ProductionBuildingType, std::uint64_t, PRODUCTION_BUILDING_TYPES> masks{};
+        for (std::size_t i = 0; i < PRODUCTION_BUILDING_TYPES; i++) {
+            for (const auto unit: PRODUCTION_BUILDING_CATALOG[i].getProductionList()) {
+                masks.values[i] |= unitBit(unit);
+            }
         }
-    };
+        return masks;
+    }();
+
+    /*
+     * The production buildings of an enemy: the amount of each type and which types the enemy has at all.
+     * It is trivially copyable, the static data of each type lives in the PRODUCTION_BUILDING_CATALOG.
+     * It also keeps bitmasks of the units that can be produced and of the buildings whose building requirement
+     * is met. These are only recomputed when a type is added or an amount crosses 1.
+     */
+    class ProductionBuildings {
+        EnumArray<ProductionBuildingType, float, PRODUCTION_BUILDING_TYPES> _amounts{};
+        std::uint32_t _present = 0;
+        std::uint32_t _producing = 0;
+        std::uint32_t _requirementsMet = 0;
+        std::uint64_t _producibleUnits = 0;
 
-    struct StarportProductionBuilding : public ProductionBuilding {
-        explicit StarportProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::Starport ,
-            amount,
-            0,
-            ProductionBuildingType::Factory,
-            std::vector<EnemyUnitType> {EnemyUnitType::VIKINGFIGHTER,
-                                        EnemyUnitType::MEDIVAC,
-                                        EnemyUnitType::LIBERATOR,
-                                        EnemyUnitType::RAVEN,
-                                        EnemyUnitType::BANSHEE,
-                                        EnemyUnitType::BATTLECRUISER
-            })
-        {
+        void updateMasks() {
+            _producibleUnits = 0;
+            _requirementsMet = 0;
+            for (std::size_t i = 0; i < PRODUCTION_BUILDING_TYPES; i++) {
+                const auto type = static_cast<ProductionBuildingType>(i);
+                if (!contains(type)) {
+                    continue;
+                }
+                if (_producing & buildingBit(type)) {
+                    _producibleUnits |= PRODUCTION_LIST_MASKS[type];
+                }
+                // A missing required building only leaves the requirement unmet. The map this replaced inserted a
+                // default building for it, with no production list and no requirements of its own, as a side effect
+                // of looking it up with operator[] while iterating the map.
+                const auto requirement = PRODUCTION_BUILDING_CATALOG[i].buildingRequirement;
+                if (requirement == ProductionBuildingType::None || (_producing & buildingBit(requirement))) {
+                    _requirementsMet |= buildingBit(type);
+                }
+            }
         }
-    };
 
-    struct HatcheryProductionBuilding : public ProductionBuilding {
-        explicit HatcheryProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::Hatchery,
-            amount,
-            0,
-            ProductionBuildingType::None,
-            std::vector<EnemyUnitType>{}){}
-    };
-    struct SpawningPoolProductionBuilding : public ProductionBuilding {
-        explicit SpawningPoolProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::SpawningPool,
-            amount,
-            0,
-            ProductionBuildingType::None,
-            std::vector<EnemyUnitType>{ EnemyUnitType::ZERGLING, EnemyUnitType::QUEEN,})
-        {}
-    };
-    struct BanelingNestProductionBuilding : public ProductionBuilding {
-        explicit BanelingNestProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::BanelingNest,
-            amount,
-            0,
-            ProductionBuildingType::SpawningPool,
-            std::vector<EnemyUnitType>{EnemyUnitType::BANELING}){}
-    };
-    struct RoachWarrenProductionBuilding : public ProductionBuilding {
-        explicit RoachWarrenProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::RoachWarren,
-            amount,
-            0,
-            ProductionBuildingType::SpawningPool,
-            std::vector<EnemyUnitType>{EnemyUnitType::ROACH }){}
-    };
-    struct HydraliskProductionBuilding : public ProductionBuilding {
-        explicit HydraliskProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::HydraliskDen,
-            amount,
-            0,
-            ProductionBuildingType::SpawningPool,
-            std::vector<EnemyUnitType>{EnemyUnitType::HYDRALISK}){}
-    };
-    struct LurkerDenProductionBuilding : public ProductionBuilding {
-        explicit LurkerDenProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::RoachWarren,
-            amount,
-            0,
-            ProductionBuildingType::HydraliskDen,
-            std::vector<EnemyUnitType>{EnemyUnitType::LURKERMP }){}
-    };
-    struct InfestationPitProductionBuilding : public ProductionBuilding {
-        explicit InfestationPitProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::InfestationPit,
-            amount,
-            0,
-            ProductionBuildingType::SpawningPool,
-            std::vector<EnemyUnitType>{EnemyUnitType::INFESTOR,EnemyUnitType::SWARMHOSTMP}){}
-    };
-    struct SpireProductionBuilding : public ProductionBuilding {
-        explicit SpireProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::Spire,
-            amount,
-            0,
-            ProductionBuildingType::InfestationPit,
-            std::vector<EnemyUnitType>{EnemyUnitType::MUTALISK,EnemyUnitType::CORRUPTOR, EnemyUnitType::BROODLORD}){}
-    };
-    struct UltraliskCavernProductionBuilding : public ProductionBuilding {
-        explicit UltraliskCavernProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::UltraliskCavern,
-            amount,
-            0,
-            ProductionBuildingType::InfestationPit,
-            std::vector<EnemyUnitType>{EnemyUnitType::ULTRALISK}){}
-    };
+    public:
+        [[nodiscard]] bool contains(const ProductionBuildingType type) const { return (_present & buildingBit(type)) != 0; }
+        [[nodiscard]] float getAmount(const ProductionBuildingType type) const { return _amounts[type]; }
+        // The types the enemy has, as a bitmask indexed by ProductionBuildingType
+        [[nodiscard]] std::uint32_t getPresent() const { return _present; }
+        [[nodiscard]] bool empty() const { return _present == 0; }
+        // The units of every building with an amount of at least 1, as a bitmask indexed by EnemyUnitType
+        [[nodiscard]] std::uint64_t getProducibleUnits() const { return _producibleUnits; }
+        // The types the enemy has whose building requirement is met, ignoring time requirements
+        [[nodiscard]] std::uint32_t getRequirementsMet() const { return _requirementsMet; }
 
-    struct GatewayProductionBuilding : public ProductionBuilding {
-        explicit GatewayProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::Gateway,
-            amount,
-            0,
-            ProductionBuildingType::None,
-            std::vector<EnemyUnitType>{ EnemyUnitType::ZEALOT,
-                                        EnemyUnitType::STALKER,
-                                        EnemyUnitType::SENTRY,
-                                        EnemyUnitType::ADEPT,
-                                        EnemyUnitType::DARKTEMPLAR,
-                                        EnemyUnitType::HIGHTEMPLAR}){}
-    };
-    struct StargateProductionBuilding : public ProductionBuilding {
-        explicit StargateProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::Stargate,
-            amount,
-            0,
-            ProductionBuildingType::Gateway,
-            std::vector<EnemyUnitType>{ EnemyUnitType::PHOENIX,
-                                        EnemyUnitType::VOIDRAY,
-                                        EnemyUnitType::ORACLE,
-                                        EnemyUnitType::TEMPEST,
-                                        EnemyUnitType::CARRIER}){}
-    };
-    struct RoboticsFacilityProductionBuilding : public ProductionBuilding {
-        explicit RoboticsFacilityProductionBuilding(const float amount) : ProductionBuilding(ProductionBuildingType::RoboticsFacility,
-            amount,
-            0,
-            ProductionBuildingType::Gateway,
-            std::vector<EnemyUnitType>{ EnemyUnitType::WARPPRISM,
-                                        EnemyUnitType::OBSERVER,
-                                        EnemyUnitType::IMMORTAL,
-                                        EnemyUnitType::COLOSSUS,
-                                        EnemyUnitType::DISRUPTOR}){}
+        void setAmount(const ProductionBuildingType type, const float amount) {
+            if (type == ProductionBuildingType::None) {
+                return;
+            }
+            _amounts[type] = amount;
+
+            const auto present = _present | buildingBit(type);
+            const auto producing = amount >= 1 ? _producing | buildingBit(type) : _producing & ~buildingBit(type);
+            if (present != _present || producing != _producing) {
+                _present = present;
+                _producing = producing;
+                updateMasks();
+            }
+        }
+
+        friend bool operator==(const ProductionBuildings &left, const ProductionBuildings &right) = default;
     };
 
-    inline std::unordered_map<ProductionBuildingType, ProductionBuilding> convertToProductionBuildings(
-        const std::map<ProductionBuildingType, int> & buildingAmounts) {
-        std::unordered_map<ProductionBuildingType, ProductionBuilding> buildings;
+    inline ProductionBuildings convertToProductionBuildings(const std::map<ProductionBuildingType, int> &buildingAmounts) {
+        ProductionBuildings buildings;
         for (auto [type, amount]: buildingAmounts) {
-            switch (type) {
-                case ProductionBuildingType::Barracks:
-                    buildings[type] = BarracksProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::Factory:
-                    buildings[type] = FactoryProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::Starport:
-                    buildings[type] = StarportProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::Hatchery:
-                    buildings[type] = HatcheryProductionBuilding(amount);
-                case ProductionBuildingType::HydraliskDen:
-                    buildings[type] = HydraliskProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::LurkerDen:
-                    buildings[type] = LurkerDenProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::UltraliskCavern:
-                    buildings[type] = UltraliskCavernProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::SpawningPool:
-                    buildings[type] = SpawningPoolProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::RoachWarren:
-                    buildings[type] = RoachWarrenProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::Spire:
-                    buildings[type] = SpireProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::BanelingNest:
-                    buildings[type] = BanelingNestProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::InfestationPit:
-                    buildings[type] = InfestationPitProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::RoboticsFacility:
-                    buildings[type] = RoboticsFacilityProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::Gateway:
-                    buildings[type] = GatewayProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::Stargate:
-                    buildings[type] = StargateProductionBuilding(amount);
-                    break;
-                case ProductionBuildingType::None:
-                    break;
-            }
+            buildings.setAmount(type, static_cast<float>(amount));
         }
         return buildings;
     };
@@ -4,9 +4,13 @@
 
 #ifndef UNITTYPES_H
 #define UNITTYPES_H
+#include <cstddef>
+#include <map>
 #include <string>
 #include <unordered_map>
 
+#include "EnumArray.h"
+
 enum class EnemyUnitType {
     COLOSSUS,
     BANELING,
@@ -68,6 +72,10 @@ enum class EnemyUnitType {
     Last
 };
 
+static constexpr std::size_t ENEMY_UNIT_TYPES = static_cast<std::size_t>(EnemyUnitType::Last);
+// The amount of each enemy unit type
+using EnemyUnits = Sc2::EnumArray<EnemyUnitType, int, ENEMY_UNIT_TYPES>;
+
 inline std::unordered_map<std::string, EnemyUnitType> stringToUnitType = {
     {"enemy:COLOSSUS", EnemyUnitType::COLOSSUS},
     {"enemy:BANELING", EnemyUnitType::BANELING},
@@ -128,17 +136,12 @@ inline std::unordered_map<std::string, EnemyUnitType> stringToUnitType = {
     {"enemy:DISRUPTOR", EnemyUnitType::DISRUPTOR},
 };
 
-static std::map<EnemyUnitType, int> convertToEnum(const std::map<std::string, int> & unitStrings) {
-    std::map<EnemyUnitType, int>unitMap = {};
-    // Initialize all units to 0
-    for (int i = static_cast<int>(EnemyUnitType::COLOSSUS); i != static_cast<int>(EnemyUnitType::Last); i++ ) {
-        unitMap[static_cast<EnemyUnitType>(i)] = 0;
-    }
-
+static EnemyUnits convertToEnum(const std::map<std::string, int> & unitStrings) {
+    EnemyUnits units = {};
     for (auto [str, amount]: unitStrings) {
         auto type = stringToUnitType[str];
-        unitMap[type] = amount;
+        units[type] = amount;
     }
-    return unitMap;
+    return units;
 };
 #endif //UNITTYPES_H
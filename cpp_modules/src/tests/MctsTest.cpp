@@ -2,7 +2,10 @@
 // Created by marco on 07/11/2024.
 //
 #include <Mcts.h>
+#include <MctsEnsemble.h>
+#include <algorithm>
 #include <ranges>
+#include <set>
 
 #include "doctest.h"
 #include "Node.h"
@@ -10,28 +13,181 @@
 
 using namespace Sc2::Mcts;
 
+namespace {
+	// A tree searched from a new state with a fixed seed
+	Mcts seededMcts(const ValueHeuristic valueHeuristic = ValueHeuristic::UCT) {
+		return Mcts(std::make_shared<Sc2::State>(), 0, 100, sqrt(2), valueHeuristic, RolloutHeuristic::Random, 0,
+		            Sc2::ArmyValueFunction::MinPower);
+	}
+
+	// Checks that every visit of the root went through one of its children, with no virtual loss left behind
+	void checkVisitsAddUp(const Node &root) {
+		CHECK(root.getEffectiveVisits() == root.getVisits());
+		int childVisits = 0;
+		for (const auto child: root.getChildren()) {
+			CHECK(child->getEffectiveVisits() == child->getVisits());
+			childVisits += child->getVisits();
+		}
+		CHECK(childVisits == root.getVisits());
+	}
+
+	// The distinct states of the nodes in the tree below the root
+	std::size_t countDistinctStates(Node &root) {
+		std::set<std::uint64_t> hashes;
+		std::vector stack = {&root};
+		while (!stack.empty()) {
+			const auto node = stack.back();
+			stack.pop_back();
+			if (node->getState() != nullptr) {
+				hashes.insert(node->getState()->hash());
+			}
+			for (const auto child: node->getChildren()) {
+				stack.push_back(child);
+			}
+		}
+		return hashes.size();
+	}
+}
+
 TEST_SUITE("Test MCTS") {
 	TEST_CASE("Can create a Node") {
 		const auto state = std::make_shared<Sc2::State>();
-		auto node = std::make_shared<Node>(Action::none, nullptr, state);
+		NodePool pool;
+		auto node = pool.create(Action::none, nullptr, state);
 		CHECK(node->N == 0);
-		CHECK(node->children.size() == 0);
+		CHECK(node->getChildren().size() == 0);
 
 		SUBCASE("Can add children to a node") {
 			const std::vector possibleActions = {Action::buildWorker, Action::buildBase};
 			node->addChildren(possibleActions);
-			CHECK(node->children.size() == possibleActions.size());
+			CHECK(node->getChildActions().size() == possibleActions.size());
+		}
+
+		SUBCASE("Children are only built once they are asked for") {
+			node->addChildren({Action::buildWorker, Action::buildBase});
+			CHECK(node->getChildren().empty());
+			CHECK(node->getChild(Action::buildWorker) == nullptr);
+
+			const auto child = node->getOrAddChild(Action::buildWorker);
+			REQUIRE(child != nullptr);
+			CHECK(child->getAction() == Action::buildWorker);
+			CHECK(child->getState()->getIncomingWorkers() == 1);
+			CHECK(node->getOrAddChild(Action::buildWorker) == child);
+			CHECK(node->getChildren().size() == 1);
+			CHECK(node->getOrAddChild(Action::buildMarine) == nullptr);
 		}
 
 		const std::vector possibleActions = {Action::buildWorker, Action::buildBase};
 		node->addChildren(possibleActions);
+		for (const auto action: possibleActions) {
+			node->getOrAddChild(action);
+		}
 
 		SUBCASE("The children of the nodes parent points to the correct object") {
-			CHECK(node->children.size() > 0);
-			for (auto const &child: std::ranges::views::values(node->children)) {
+			CHECK(node->getChildren().size() > 0);
+			for (const auto child: node->getChildren()) {
 				CHECK((child->getParent()) == node);
 			}
 		}
+
+		SUBCASE("Released nodes are reused for new nodes") {
+			const auto child = node->getChild(Action::buildWorker);
+			REQUIRE(child != nullptr);
+			child->expand();
+			for (const auto action: child->getChildActions()) {
+				child->getOrAddChild(action);
+			}
+			REQUIRE(child->getChildren().size() > 0);
+			std::vector released = {child->getIndex()};
+			for (const auto grandchild: child->getChildren()) {
+				released.push_back(grandchild->getIndex());
+			}
+			const auto capacity = pool.capacity();
+
+			pool.release(*child);
+			CHECK(node->getChild(Action::buildWorker) == nullptr);
+			CHECK(node->getChildren().size() == 1);
+
+			std::vector<NodeIndex> reused;
+			for (std::size_t i = 0; i < released.size(); i++) {
+				reused.push_back(pool.create(Action::none, nullptr, std::make_shared<Sc2::State>())->getIndex());
+			}
+			std::ranges::sort(released);
+			std::ranges::sort(reused);
+			CHECK(reused == released);
+			CHECK(pool.capacity() == capacity);
+		}
+
+		SUBCASE("Reclaiming released nodes frees their states before they are reused") {
+			const auto child = node->getChild(Action::buildWorker);
+			REQUIRE(child != nullptr);
+			child->expand();
+			for (const auto action: child->getChildActions()) {
+				child->getOrAddChild(action);
+			}
+			std::vector released = {child};
+			for (const auto grandchild: child->getChildren()) {
+				released.push_back(grandchild);
+			}
+
+			pool.release(*child);
+			CHECK(pool.reclaim(1) == 1);
+			CHECK(pool.reclaim(released.size()) == released.size() - 1);
+			CHECK(pool.reclaim(released.size()) == 0);
+			for (const auto reclaimed: released) {
+				CHECK(reclaimed->getState() == nullptr);
+			}
+
+			const auto reused = pool.create(Action::none, nullptr, std::make_shared<Sc2::State>());
+			CHECK(std::ranges::find(released, reused) != released.end());
+			CHECK(reused->getState() != nullptr);
+		}
+
+		SUBCASE("Nodes with the same state share their statistics through the transposition table") {
+			TranspositionTable transpositions;
+			NodePool sharedPool(&transpositions);
+			const auto root = sharedPool.create(Action::none, nullptr, std::make_shared<Sc2::State>());
+			root->addChildren({Action::buildWorker});
+			const auto first = root->getOrAddChild(Action::buildWorker);
+			const auto second = sharedPool.create(Action::none, nullptr, Sc2::State::DeepCopy(*first->getState()));
+			CHECK(transpositions.size() == 2);
+
+			first->update(1.0);
+			first->update(0.0);
+			second->update(1.0);
+			CHECK(second->getVisits() == 1);
+			CHECK(first->getMeanValue() == doctest::Approx(2.0 / 3.0));
+			CHECK(second->getMeanValue() == doctest::Approx(2.0 / 3.0));
+		}
+
+		SUBCASE("A batch of outcomes updates the statistics like the outcomes one at a time") {
+			const auto batched = node->getChild(Action::buildWorker);
+			const auto single = node->getChild(Action::buildBase);
+			REQUIRE(batched != nullptr);
+			REQUIRE(single != nullptr);
+			single->update(0.25);
+			batched->update(0.25);
+
+			Outcomes outcomes;
+			for (const auto outcome: {0.5, 0.125, 1.0, 0.75}) {
+				single->update(outcome);
+				outcomes.add(outcome);
+			}
+			batched->update(outcomes);
+
+			CHECK(batched->N == single->N);
+			CHECK(batched->Q == doctest::Approx(single->Q));
+			CHECK(batched->M2 == doctest::Approx(single->M2));
+		}
+
+		SUBCASE("A child becomes the root of its own tree") {
+			const auto child = node->getChild(Action::buildBase);
+			REQUIRE(child != nullptr);
+			pool.makeRoot(*child);
+
+			CHECK(child->getParent() == nullptr);
+			CHECK(node->getChild(Action::buildBase) == nullptr);
+		}
 	}
 
 
@@ -56,6 +212,225 @@ TEST_SUITE("Test MCTS") {
 
 			CHECK(bestMove != Action::none);
 		}
+		SUBCASE("A copy of the root stays valid once the root has moved on") {
+			auto mcts = seededMcts();
+			mcts.searchRollout(200);
+			auto copy = mcts.getRootNodeCopy();
+			const auto population = copy.getState()->getPopulation();
+
+			mcts.performAction(mcts.getBestAction());
+			mcts.searchRollout(200);
+			CHECK(copy.getVisits() == 200);
+			CHECK(copy.getState()->getPopulation() == population);
+			// It is on its own, without a parent, children or a pool to build them in
+			CHECK(copy.getParent() == nullptr);
+			CHECK(copy.getChildren().empty());
+			CHECK(copy.getOrAddChild(copy.getChildActions().front()) == nullptr);
+		}
+		SUBCASE("Several threads can search the same tree") {
+			auto mcts = seededMcts();
+
+			mcts.startSearchRolloutThread(2000, 4);
+			mcts.stopSearchThread();
+
+			const auto rollouts = mcts.getNumberOfRollouts();
+			CHECK(rollouts >= 2000);
+
+			const auto root = mcts.getRootNode();
+			CHECK(root->getVisits() == rollouts);
+			checkVisitsAddUp(*root);
+			CHECK(mcts.getBestAction() != Action::none);
+		}
+		SUBCASE("Requests are answered while the search threads run") {
+			auto mcts = seededMcts();
+			mcts.setSearchBatch(4);
+			mcts.startSearchThread(2);
+
+			unsigned int rollouts = 0;
+			while (rollouts < 500) {
+				rollouts = mcts.getNumberOfRollouts();
+			}
+			const auto bestAction = mcts.getBestAction();
+			mcts.stopSearchThread();
+			CHECK(bestAction != Action::none);
+
+			// The snapshot the best action was read from is no newer than the search
+			CHECK(mcts.getSnapshot()->rollouts <= mcts.getNumberOfRollouts());
+
+			const auto latencies = mcts.getRequestLatencies();
+			const auto batchLatency = std::ranges::find_if(latencies, [](const auto &latency) {
+				return latency.request == "set_search_batch";
+			});
+			REQUIRE(batchLatency != latencies.end());
+			CHECK(batchLatency->count == 1);
+			CHECK(batchLatency->p50 <= batchLatency->p99);
+		}
+		SUBCASE("An open loop tree keeps no states below the root") {
+			auto mcts = seededMcts();
+			mcts.setOpenLoop(true);
+			REQUIRE(mcts.isOpenLoop());
+			mcts.startSearchRolloutThread(1000, 2);
+			mcts.stopSearchThread();
+
+			const auto root = mcts.getRootNode();
+			CHECK(root->getState() != nullptr);
+			CHECK(root->getVisits() == mcts.getNumberOfRollouts());
+			checkVisitsAddUp(*root);
+			for (const auto child: root->getChildren()) {
+				CHECK(child->getState() == nullptr);
+			}
+
+			// The new root gets a state of its own by taking the action in the root state
+			const auto bestAction = mcts.getBestAction();
+			REQUIRE(bestAction != Action::none);
+			const auto expected = Sc2::State::DeepCopy(*root->getState());
+			expected->performAction(bestAction);
+			mcts.performAction(bestAction);
+			const auto newRoot = mcts.getRootNode();
+			REQUIRE(newRoot->getState() != nullptr);
+			CHECK(newRoot->getState()->getPopulation() == expected->getPopulation());
+			CHECK(newRoot->getState()->getIncomingPopulation() == expected->getIncomingPopulation());
+			mcts.searchRollout(200);
+			CHECK(mcts.getBestAction() != Action::none);
+		}
+		SUBCASE("The tree is pruned to its memory budget and stops growing once it reaches it") {
+			auto mcts = seededMcts();
+			mcts.searchRollout(2000);
+			const auto unbudgeted = mcts.getTreeMemory();
+			CHECK(unbudgeted.nodes == unbudgeted.states);
+			CHECK(unbudgeted.bytes >= unbudgeted.nodes * (sizeof(Node) + sizeof(Sc2::State)));
+			CHECK(unbudgeted.budget == 0);
+
+			const auto rootActions = mcts.getRootNode()->getChildMask();
+			const auto budget = unbudgeted.bytes / 2;
+			mcts.setMemoryBudget(budget);
+			const auto pruned = mcts.getTreeMemory();
+			CHECK(pruned.budget == budget);
+			CHECK(pruned.bytes <= budget / 4 * 3);
+			CHECK(pruned.prunedNodes == unbudgeted.nodes - pruned.nodes);
+			CHECK(pruned.transpositions == countDistinctStates(*mcts.getRootNode()));
+			// The chunks the pruned nodes were in are kept for the nodes still to be built
+			CHECK(pruned.reservedBytes >= unbudgeted.nodes * sizeof(Node));
+			// The children of the root keep the statistics of its actions
+			CHECK(mcts.getRootNode()->getChildMask() == rootActions);
+
+			// At most a single node is built past the budget before the search stops building them
+			mcts.searchRollout(2000);
+			CHECK(mcts.getNumberOfRollouts() == 4000);
+			CHECK(mcts.getTreeMemory().bytes <= budget + sizeof(Node) + 2 * sizeof(Sc2::State));
+			CHECK(mcts.getBestAction() != Action::none);
+
+			// The root and its children alone are over this budget, once nothing else is left the tree is not pruned
+			// again until the root moves
+			const auto prunes = [&mcts] {
+				const auto latencies = mcts.getRequestLatencies();
+				return std::ranges::find_if(latencies, [](const auto &latency) {
+					return latency.request == "prune_tree";
+				})->count;
+			};
+			const auto prunesBefore = prunes();
+			mcts.setMemoryBudget(1);
+			mcts.searchRollout(500);
+			CHECK(prunes() == prunesBefore + 1);
+
+			mcts.setMemoryBudget(0);
+			mcts.searchRollout(1000);
+			CHECK(mcts.getTreeMemory().bytes > budget);
+		}
+		SUBCASE("A posted root is adopted by the search threads") {
+			auto mcts = seededMcts();
+			const auto updatedState = std::make_shared<Sc2::State>();
+			updatedState->performAction(Action::buildWorker);
+
+			// Without search threads the root is adopted right away
+			const auto first = mcts.postRootState(updatedState);
+			CHECK(mcts.getAdoptedRoot() == first);
+			CHECK(mcts.getRootState()->getIncomingWorkers() == 1);
+
+			mcts.startSearchThread(2);
+			const auto second = mcts.postRootState(updatedState, {Action::buildWorker});
+			CHECK(second > first);
+			mcts.waitForRoot(second);
+			CHECK(mcts.getAdoptedRoot() == second);
+			mcts.stopSearchThread();
+
+			// The actions posted with the root are taken once it has been adopted
+			const auto expected = Sc2::State::DeepCopy(*updatedState);
+			expected->performAction(Action::buildWorker);
+			const auto rootState = mcts.getRootState();
+			CHECK(rootState->getMinerals() == expected->getMinerals());
+			CHECK(rootState->getPopulation() == expected->getPopulation());
+			CHECK(rootState->getIncomingWorkers() == expected->getIncomingWorkers());
+		}
+		SUBCASE("The transposition table only keeps the states of the tree as the root moves") {
+			auto mcts = seededMcts();
+			for (int i = 0; i < 5; i++) {
+				mcts.searchRollout(300);
+				mcts.performAction(mcts.getBestAction());
+				CHECK(mcts.getTranspositionCount() == countDistinctStates(*mcts.getRootNode()));
+
+				mcts.searchRollout(300);
+				mcts.postRootState(mcts.getRootState(), {mcts.getBestAction()});
+				CHECK(mcts.getTranspositionCount() == countDistinctStates(*mcts.getRootNode()));
+			}
+
+			mcts.setTranspositions(false);
+			CHECK(mcts.getTranspositionCount() == 0);
+			mcts.searchRollout(300);
+			CHECK(mcts.getTranspositionCount() == 0);
+		}
+		SUBCASE("Several rollouts can be run from each selected node") {
+			auto mcts = seededMcts();
+			mcts.setLeafParallelism(4, 2);
+
+			mcts.searchRollout(1000);
+
+			CHECK(mcts.getNumberOfRollouts() == 1000);
+			const auto root = mcts.getRootNode();
+			CHECK(root->getVisits() == 1000);
+			// Every leaf was visited by whole batches of rollouts
+			for (const auto child: root->getChildren()) {
+				CHECK(child->getVisits() % 4 == 0);
+			}
+			CHECK(mcts.getBestAction() != Action::none);
+		}
+		SUBCASE("An ensemble of trees searches them independently and merges their statistics") {
+			const auto state = std::make_shared<Sc2::State>();
+			auto ensemble = MctsEnsemble(state, 0, 100, sqrt(2), ValueHeuristic::UCT, RolloutHeuristic::Random, 0,
+			                             Sc2::ArmyValueFunction::MinPower, 3);
+
+			ensemble.searchRollout(3000);
+
+			CHECK(ensemble.getNumberOfRollouts() == 3000);
+			for (int i = 0; i < ensemble.getTreeCount(); i++) {
+				CHECK(ensemble.getTree(i).getNumberOfRollouts() == 1000);
+			}
+
+			const auto bestAction = ensemble.getBestAction();
+			REQUIRE(bestAction != Action::none);
+
+			// The trees all follow the action that is taken
+			ensemble.performAction(bestAction);
+			const auto expected = Sc2::State::DeepCopy(*state);
+			expected->performAction(bestAction);
+			for (int i = 0; i < ensemble.getTreeCount(); i++) {
+				const auto rootState = ensemble.getTree(i).getRootState();
+				CHECK(rootState->getMinerals() == expected->getMinerals());
+				CHECK(rootState->getWorkerPopulation() == expected->getWorkerPopulation());
+				CHECK(rootState->getOccupiedPopulation() == expected->getOccupiedPopulation());
+			}
+
+			// Every tree numbers the posted root alike and has adopted it once the wait returns
+			ensemble.startSearchThread();
+			const auto sequence = ensemble.postRootState(expected, {bestAction});
+			ensemble.waitForRoot(sequence);
+			ensemble.stopSearchThread();
+			expected->performAction(bestAction);
+			for (int i = 0; i < ensemble.getTreeCount(); i++) {
+				CHECK(ensemble.getTree(i).getAdoptedRoot() == sequence);
+				CHECK(ensemble.getTree(i).getRootState()->getMinerals() == expected->getMinerals());
+			}
+		}
 	}
 
 	TEST_CASE("Can update the state correctly") {
@@ -93,6 +468,31 @@ TEST_SUITE("Test MCTS") {
 			CHECK(rootState->getConstructions().size() == updatedState->getConstructions().size());
 			CHECK(rootState->getConstructions().size() != state->getConstructions().size());
 		}
+		SUBCASE("A new root state that matches a node of the tree keeps the search below it") {
+			mcts.searchRollout(300);
+			const auto child = mcts.getRootNode()->getChild(Action::buildWorker);
+			REQUIRE(child != nullptr);
+			const auto visits = child->getVisits();
+			REQUIRE(visits > 0);
+
+			mcts.updateRootState(Sc2::State::DeepCopy(*child->getState()));
+			CHECK(mcts.getRootNode() == child);
+			CHECK(mcts.getNumberOfRollouts() == static_cast<unsigned int>(visits));
+			auto reuse = mcts.getTreeReuse();
+			CHECK(reuse.attempts == 1);
+			CHECK(reuse.hits == 1);
+			CHECK(reuse.reusedVisits == static_cast<std::uint64_t>(visits));
+
+			// A state with other units matches nothing, and replaces the tree
+			const auto other = std::make_shared<Sc2::State>();
+			other->performAction(Action::buildBase);
+			mcts.updateRootState(other);
+			CHECK(mcts.getNumberOfRollouts() == 0);
+			reuse = mcts.getTreeReuse();
+			CHECK(reuse.attempts == 2);
+			CHECK(reuse.hits == 1);
+			CHECK(reuse.hitRate() == doctest::Approx(0.5));
+		}
 		SUBCASE("Can update the state in an MCTS using values of a state") {
 			const auto updatedState = std::make_shared<Sc2::State>();
 			updatedState->performAction(Action::buildWorker);
@@ -121,7 +521,6 @@ TEST_SUITE("Test MCTS") {
 			auto factoryAmount = updatedState->getFactoryAmount();
 			auto starPortAmount = updatedState->getStarPortAmount();
 			auto constructions = updatedState->getConstructions();
-			auto enemyCombatUnits = updatedState->getEnemyCombatUnits();
 			auto hasHouse = updatedState->getHasHouse();
 			auto incomingHouse = updatedState->getIncomingHouse();
 			auto incomingBarracks = updatedState->getIncomingBarracks();
@@ -202,7 +601,6 @@ TEST_SUITE("Test MCTS") {
 		auto barracksAmount = state->getBarracksAmount();
 		auto factoryAmount = state->getFactoryAmount();
 		auto starPortAmount = state->getStarPortAmount();
-		auto enemyCombatUnits = state->getEnemyCombatUnits();
 		auto hasHouse = state->getHasHouse();
 		auto incomingHouse = state->getIncomingHouse();
 		auto incomingBarracks = state->getIncomingBarracks();
@@ -211,7 +609,7 @@ TEST_SUITE("Test MCTS") {
 		auto incomingBases = state->getIncomingBases();
 		auto maxBases = state->getMaxBases();
 
-		auto constructions = std::list<Sc2::Construction>();
+		auto constructions = std::vector<Sc2::Construction>();
 		constructions.emplace_back(state->getBuildWorkerCost().buildTime - 1, Action::buildWorker);
 
 
@@ -260,6 +658,14 @@ TEST_SUITE("Test MCTS") {
 	}
 
 
+	TEST_CASE("The total win probability weighs each win by the probability of reaching its state") {
+		const std::vector winProbabilities = {0.1, 0.2, 0.4};
+		const std::vector continueProbabilities = {0.5, 0.25, 0.0};
+		CHECK(Mcts::calculateTotalWinProbability(winProbabilities, continueProbabilities) ==
+			doctest::Approx(0.1 + 0.5 * 0.2 + 0.5 * 0.25 * 0.4));
+		CHECK(Mcts::calculateTotalWinProbability({}, {}) == 0);
+	}
+
 	TEST_CASE("Select Node will select a node that has not been fully explored") {
 		const auto state = std::make_shared<Sc2::State>();
 
@@ -270,10 +676,26 @@ TEST_SUITE("Test MCTS") {
 		auto node = mcts->selectNode();
 
 		CHECK(node->N == 0);
-		CHECK(node->children.size() == 0);
+		CHECK(node->getChildren().size() == 0);
 		CHECK(node->getDepth() > 1);
 	}
 
+	TEST_CASE("Select Node picks children that only have virtual loss with the normal heuristics") {
+		for (const auto valueHeuristic: {ValueHeuristic::UCB1Normal2, ValueHeuristic::UCB1Normal}) {
+			auto mcts = seededMcts(valueHeuristic);
+			const auto root = mcts.getRootNode();
+			root->expand();
+			// Threads that descended together leave virtual loss on children before any of them has a visit
+			for (const auto action: root->getChildActions()) {
+				root->getOrAddChild(action)->addVirtualLoss(2);
+			}
+
+			const auto node = mcts.selectNode();
+			CHECK(node->getParent() == root);
+			CHECK(node->getVisits() == 0);
+		}
+	}
+
 
 	TEST_CASE("Expand will expand with all available actions in a state") {
 		const auto rootState = std::make_shared<Sc2::State>();
@@ -292,7 +714,15 @@ TEST_SUITE("Test MCTS") {
 
 			node->expand();
 
-			CHECK(node->children.size() == numberOfLegalActions);
+			CHECK(node->getChildActions().size() == numberOfLegalActions);
+			std::uint16_t legalMask = 0;
+			for (const auto action: state->getLegalActions()) {
+				legalMask |= actionBit(action);
+				REQUIRE(node->getOrAddChild(action) != nullptr);
+				CHECK(node->getChild(action)->getAction() == action);
+			}
+			CHECK(node->getActionMask() == legalMask);
+			CHECK(node->getChildMask() == legalMask);
 		}
 
 		SUBCASE("expand will not include build worker when the population limit is reached") {
@@ -306,10 +736,10 @@ TEST_SUITE("Test MCTS") {
 
 			node->expand();
 
-			for (const auto action: node->children | std::views::keys) {
+			for (const auto action: node->getChildActions()) {
 				CHECK(action != Action::buildWorker);
 			}
-			CHECK(node->children.size() == state->getLegalActions().size());
+			CHECK(node->getChildActions().size() == state->getLegalActions().size());
 		}
 		SUBCASE("expand will not include build vespene collector when there is no available geysers") {
 			auto node = mcts.selectNode();
@@ -327,10 +757,10 @@ TEST_SUITE("Test MCTS") {
 			CHECK(availableGeysers == 0);
 
 			node->expand();
-			for (const auto action: node->children | std::views::keys) {
+			for (const auto action: node->getChildActions()) {
 				CHECK(action != Action::buildVespeneCollector);
 			}
-			CHECK(node->children.size() == state->getLegalActions().size());
+			CHECK(node->getChildActions().size() == state->getLegalActions().size());
 		}
 	}
 }
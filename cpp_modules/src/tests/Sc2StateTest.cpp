@@ -7,6 +7,8 @@
 #include "Sc2State.h"
 #include "Enemy.h"
 
+#include <array>
+#include <cmath>
 #include <iostream>
 
 
@@ -186,6 +188,38 @@ TEST_SUITE("Test the Sc2State") {
 		}
 	}
 
+	TEST_CASE("Constructions and occupied workers beyond the number of workers are paused") {
+		const std::vector<Sc2::Base> bases = {Sc2::Base()};
+		const std::vector<Sc2::Construction> constructions = {
+			Sc2::Construction(1, Action::buildWorker),
+			Sc2::Construction(1, Action::buildMarine),
+		};
+		const std::vector<int> occupiedWorkerTimers = {1, 1};
+		const auto state = Sc2::State::InternalStateBuilder({
+			                                                    .workerPopulation = 1,
+			                                                    .incomingWorkers = 1,
+			                                                    .incomingMarines = 1,
+			                                                    .populationLimit = 15,
+			                                                    .bases = bases,
+			                                                    .constructions = constructions,
+			                                                    .occupiedWorkerTimers = occupiedWorkerTimers,
+			                                                    .endTime = 100,
+		                                                    }, 1, Sc2::ArmyValueFunction::MinPower, 0);
+
+		state->wait();
+		// Only the first construction and the last occupied worker had a worker to advance them
+		CHECK(state->getWorkerPopulation() == 2);
+		CHECK(state->getMarinePopulation() == 0);
+		CHECK(state->getConstructions().size() == 1);
+		CHECK(state->getConstructions().front().getTimeLeft() == 1);
+		CHECK(state->getOccupiedWorkerTimers() == std::vector<int>{1});
+
+		state->wait();
+		CHECK(state->getMarinePopulation() == 1);
+		CHECK(state->getConstructions().empty());
+		CHECK(state->getOccupiedWorkerTimers().empty());
+	}
+
 	TEST_CASE("Test that you can not build more workers than the population cap") {
 		const auto state = std::make_shared<Sc2::State>();
 		state->wait(100);
@@ -204,6 +238,79 @@ TEST_SUITE("Test the Sc2State") {
 		CHECK(state->getPopulation() == state->getPopulationLimit());
 	}
 
+	TEST_CASE("Waiting for an action to become affordable matches waiting one timestep at a time") {
+		auto state = Sc2::State(480, 1, Sc2::ArmyValueFunction::MinPower, 42);
+		state.buildWorker();
+		state.buildHouse();
+		auto stepped = state;
+
+		state.buildBase();
+		const int waited = state.getCurrentTime() - stepped.getCurrentTime();
+		CHECK(waited > 1);
+		stepped.wait(waited);
+		stepped.buildBase();
+
+		CHECK(state.getCurrentTime() == stepped.getCurrentTime());
+		CHECK(state.getMinerals() == stepped.getMinerals());
+		CHECK(state.getVespene() == stepped.getVespene());
+		CHECK(state.getWorkerPopulation() == stepped.getWorkerPopulation());
+		CHECK(state.getPopulationLimit() == stepped.getPopulationLimit());
+		CHECK(state.getIncomingBases() == stepped.getIncomingBases());
+		CHECK(state.getConstructions().size() == stepped.getConstructions().size());
+		CHECK(state.getOccupiedWorkerTimers() == stepped.getOccupiedWorkerTimers());
+
+		auto enemy = state.getEnemy();
+		auto steppedEnemy = stepped.getEnemy();
+		CHECK(enemy.groundPower == steppedEnemy.groundPower);
+		CHECK(enemy.airPower == steppedEnemy.airPower);
+		CHECK(enemy.enemyCombatUnits == steppedEnemy.enemyCombatUnits);
+		CHECK(enemy.units == steppedEnemy.units);
+		CHECK(enemy.takeAction(state.getCurrentTime()) == steppedEnemy.takeAction(stepped.getCurrentTime()));
+	}
+
+	TEST_CASE("The evaluation follows the selected army value and end probability functions") {
+		auto enemy = Sc2::Enemy(6, 1, 2, 0);
+		enemy.enemyCombatUnits = 3;
+		const auto state = Sc2::State::InternalStateBuilder({
+			                                                    .marinePopulation = 4,
+			                                                    .tankPopulation = 1,
+			                                                    .vikingPopulation = 1,
+			                                                    .endTime = 100,
+			                                                    .enemy = enemy,
+		                                                    }, 0, Sc2::ArmyValueFunction::MinPower, 0);
+		const auto softmax = [](const double first, const double second) {
+			return std::exp(first) / (std::exp(first) + std::exp(second));
+		};
+		// The ground power is 16 against 6 and the air power 14 against 2, both scaled down by 4
+		const auto ground = softmax(4, 1.5);
+		const auto air = softmax(3.5, 0.5);
+
+		CHECK(state->getCombatSuccessProbability() == doctest::Approx(std::min(ground, air)));
+		state->setArmyValueFunction(Sc2::ArmyValueFunction::AveragePower);
+		CHECK(state->getCombatSuccessProbability() == doctest::Approx((ground + air) / 2));
+		state->setArmyValueFunction(Sc2::ArmyValueFunction::ScaledPower);
+		CHECK(state->getCombatSuccessProbability() ==
+		      doctest::Approx((ground + air) / 2 * (1 - std::abs(ground - air))));
+		state->setArmyValueFunction(Sc2::ArmyValueFunction::MarinePower);
+		const auto marines = softmax(1, 0.75);
+		CHECK(state->getCombatSuccessProbability() == doctest::Approx(marines));
+
+		CHECK(state->getEndProbability() == doctest::Approx(std::pow(marines - 0.5, 2) * 4));
+		state->setEndProbabilityFunction(2);
+		const auto evaluation = state->evaluate();
+		CHECK(evaluation.combatSuccess == doctest::Approx(marines));
+		CHECK(evaluation.end == doctest::Approx(std::pow(marines - 0.5, 8) * 200));
+		const auto [win, loss, ongoing] = state->getWinProbabilities();
+		CHECK(win == doctest::Approx(evaluation.combatSuccess * evaluation.end));
+		CHECK(loss == doctest::Approx((1 - evaluation.combatSuccess) * evaluation.end));
+		CHECK(ongoing == doctest::Approx(1 - evaluation.end));
+
+		state->setEndProbabilityFunction(3);
+		CHECK_THROWS_AS(state->getEndProbability(), std::runtime_error);
+		state->setArmyValueFunction(Sc2::ArmyValueFunction::None);
+		CHECK_THROWS_AS(state->getCombatSuccessProbability(), std::invalid_argument);
+	}
+
 	TEST_CASE("Test deep copy of states") {
 		const auto state1 = std::make_shared<Sc2::State>();
 
@@ -263,6 +370,42 @@ TEST_SUITE("Test the Sc2State") {
 		}
 	}
 
+	TEST_CASE("States match when they are the same within the tolerance") {
+		const auto state = std::make_shared<Sc2::State>();
+		state->wait(200);
+		state->buildWorker();
+		const auto copy = Sc2::State::DeepCopy(*state);
+		constexpr Sc2::StateTolerance exact = {0, 0, 0};
+		CHECK(state->matches(*copy, exact));
+
+		copy->wait(10);
+		CHECK_FALSE(state->matches(*copy, exact));
+		CHECK(state->matches(*copy, {1000, 10, 1000}));
+		CHECK_FALSE(state->matches(*copy, {1000, 9, 1000}));
+
+		copy->buildWorker();
+		CHECK_FALSE(state->matches(*copy, {1000, 1000, 1000}));
+	}
+
+	TEST_CASE("States reached by taking the same actions in another order hash the same") {
+		const auto state = std::make_shared<Sc2::State>();
+		state->wait(500);
+		const auto houseFirst = Sc2::State::DeepCopy(*state);
+		state->buildWorker();
+		state->buildHouse();
+		houseFirst->buildHouse();
+		houseFirst->buildWorker();
+		CHECK(state->hash() == houseFirst->hash());
+
+		houseFirst->wait(1);
+		CHECK(state->hash() != houseFirst->hash());
+		state->wait(1);
+		CHECK(state->hash() == houseFirst->hash());
+
+		state->buildWorker();
+		CHECK(state->hash() != houseFirst->hash());
+	}
+
 	TEST_CASE("The state can build barracks and marines") {
 		const auto state = std::make_shared<Sc2::State>();
 
@@ -431,6 +574,55 @@ TEST_SUITE("Test the Sc2State") {
 		}
 	}
 
+	TEST_CASE("Test the random number generator") {
+		auto rng = Sc2::Rng(42);
+
+		SUBCASE("Generators with the same seed produce the same numbers") {
+			auto other = Sc2::Rng(42);
+			for (int i = 0; i < 100; i++) {
+				CHECK(rng() == other());
+			}
+		}
+
+		SUBCASE("Bounded integers stay below the bound and reach every value") {
+			std::vector<int> counts(6, 0);
+			for (int i = 0; i < 6000; i++) {
+				const auto value = rng.below(6);
+				REQUIRE(value < 6);
+				counts[value]++;
+			}
+			for (const auto count: counts) {
+				CHECK(count > 800);
+			}
+		}
+
+		SUBCASE("Split and jumped generators produce different streams") {
+			auto copy = rng;
+			auto split = rng.split();
+			auto jumped = copy;
+			jumped.jump();
+
+			CHECK(rng != copy);
+			CHECK(split() != rng());
+			CHECK(jumped() != copy());
+		}
+
+		SUBCASE("Binomial counts stay within the trials and have the expected mean") {
+			for (const auto &[trials, probability]: {std::pair{40, 0.1}, std::pair{300, 0.8}, std::pair{1000, 0.3}}) {
+				double sum = 0;
+				for (int i = 0; i < 4000; i++) {
+					const auto successes = rng.binomial(trials, probability);
+					REQUIRE(successes >= 0);
+					REQUIRE(successes <= trials);
+					sum += successes;
+				}
+				CHECK(sum / 4000 == doctest::Approx(trials * probability).epsilon(0.03));
+			}
+			CHECK(rng.binomial(10, 0) == 0);
+			CHECK(rng.binomial(10, 1) == 10);
+		}
+	}
+
 	TEST_CASE("Test that enemy units are correctly added") {
 		const auto state = std::make_shared<Sc2::State>();
 
@@ -440,9 +632,10 @@ TEST_SUITE("Test the Sc2State") {
 		state->addEnemyUnit();
 		CHECK(state->getEnemyCombatUnits() == 3);
 		Sc2::Enemy e = Sc2::Enemy(Sc2::EnemyRace::Terran, 0);
-		auto a = e.generateEnemyAction();
-		auto b = e;
 		e.generateEnemyAction();
+		// A copy carries the random stream along with it
+		auto copy = e;
+		CHECK(copy.generateEnemyAction() == e.generateEnemyAction());
 	}
 
 	TEST_CASE("Test Enemy") {
@@ -453,8 +646,10 @@ TEST_SUITE("Test the Sc2State") {
 			enemy.takeAction(500, Sc2::EnemyAction::addEnemyProduction);
 
 			bool productionIncreased = false;
-			for (auto [type,building]: initialProduction) {
-				productionIncreased = enemy.productionBuildings[type].amount > building.amount;
+			for (std::size_t i = 0; i < Sc2::PRODUCTION_BUILDING_TYPES; i++) {
+				const auto type = static_cast<Sc2::ProductionBuildingType>(i);
+				productionIncreased = initialProduction.contains(type) &&
+				                      enemy.productionBuildings.getAmount(type) > initialProduction.getAmount(type);
 				if (productionIncreased) {
 					break;
 				}
@@ -462,14 +657,15 @@ TEST_SUITE("Test the Sc2State") {
 			CHECK(productionIncreased);
 		}
 		SUBCASE("Enemies can add units") {
-			enemy.productionBuildings[Sc2::ProductionBuildingType::Barracks].amount = 1;
+			enemy.productionBuildings.setAmount(Sc2::ProductionBuildingType::Barracks, 1);
 			auto initialUnits = enemy.units;
 			auto initialEnemyCombatUnits = enemy.enemyCombatUnits;
 			enemy.takeAction(500, Sc2::EnemyAction::addEnemyUnit);
 
 			bool unitsIncreased = false;
-			for (auto [unit, amount]: enemy.units) {
-				unitsIncreased = initialUnits[unit] < amount;
+			for (std::size_t i = 0; i < enemy.units.size(); i++) {
+				const auto unit = EnemyUnits::key(i);
+				unitsIncreased = initialUnits[unit] < enemy.units[unit];
 				if (unitsIncreased) {
 					break;
 				}
@@ -477,6 +673,105 @@ TEST_SUITE("Test the Sc2State") {
 			CHECK(unitsIncreased);
 			CHECK(enemy.enemyCombatUnits > initialEnemyCombatUnits);
 		}
+		SUBCASE("Production buildings respect their time and building requirements") {
+			enemy.takeAction(100, Sc2::EnemyAction::addEnemyProduction);
+			CHECK(enemy.productionBuildings.getAmount(Sc2::ProductionBuildingType::Barracks) == 0);
+
+			enemy.takeAction(130, Sc2::EnemyAction::addEnemyProduction);
+			CHECK(enemy.productionBuildings.getAmount(Sc2::ProductionBuildingType::Barracks) > 0);
+			CHECK(enemy.productionBuildings.getAmount(Sc2::ProductionBuildingType::Factory) == 0);
+
+			enemy.productionBuildings.setAmount(Sc2::ProductionBuildingType::Barracks, 1);
+			// Not enough additions for the factory to reach 1, which the starport requires
+			for (int i = 0; i < 5; i++) {
+				enemy.takeAction(500, Sc2::EnemyAction::addEnemyProduction);
+			}
+			CHECK(enemy.productionBuildings.getAmount(Sc2::ProductionBuildingType::Starport) == 0);
+		}
+		SUBCASE("Only units of buildings with an amount of at least 1 are added") {
+			enemy.productionBuildings.setAmount(Sc2::ProductionBuildingType::Factory, 1.5);
+			for (int i = 0; i < 50; i++) {
+				enemy.takeAction(500, Sc2::EnemyAction::addEnemyUnit);
+			}
+
+			int factoryUnits = 0;
+			for (const auto unit: Sc2::productionBuildingInfo(Sc2::ProductionBuildingType::Factory).getProductionList()) {
+				factoryUnits += enemy.units[unit];
+			}
+			int allUnits = 0;
+			for (const auto amount: enemy.units) {
+				allUnits += amount;
+			}
+			CHECK(factoryUnits == 50);
+			CHECK(allUnits == 50);
+		}
+		SUBCASE("Sampled enemy actions follow the action weights") {
+			std::array<Sc2::EnemyAction, 60000> actions{};
+			enemy.sampleEnemyActions(actions);
+
+			int none = 0;
+			int units = 0;
+			int attacks = 0;
+			for (const auto action: actions) {
+				none += action == Sc2::EnemyAction::none;
+				units += action == Sc2::EnemyAction::addEnemyUnit;
+				attacks += action == Sc2::EnemyAction::attackPlayer;
+			}
+			// The expected counts are 35700, 8000 and 300
+			CHECK(none == doctest::Approx(35700).epsilon(0.03));
+			CHECK(units == doctest::Approx(8000).epsilon(0.06));
+			CHECK(attacks == doctest::Approx(300).epsilon(0.35));
+		}
+		SUBCASE("Advancing over a short window takes the same actions as taking them one timestep at a time") {
+			enemy.productionBuildings.setAmount(Sc2::ProductionBuildingType::Barracks, 2);
+			auto stepped = enemy;
+
+			enemy.advance(80, 100);
+			for (int time = 81; time <= 100; time++) {
+				stepped.takeAction(time);
+			}
+
+			CHECK(enemy.units == stepped.units);
+			CHECK(enemy.groundPower == stepped.groundPower);
+			CHECK(enemy.groundProduction == stepped.groundProduction);
+			CHECK(enemy.enemyCombatUnits == stepped.enemyCombatUnits);
+		}
+		SUBCASE("Advancing over a long window follows the same distribution as taking the actions one at a time") {
+			constexpr int runs = 2000;
+			double groundPower[2] = {};
+			double airPower[2] = {};
+			double airProduction[2] = {};
+			double combatUnits[2] = {};
+			double units[2] = {};
+			for (unsigned int seed = 0; seed < runs; seed++) {
+				Sc2::Enemy advanced(Sc2::EnemyRace::Terran, seed);
+				advanced.productionBuildings.setAmount(Sc2::ProductionBuildingType::Barracks, 2);
+				auto stepped = advanced;
+
+				advanced.advance(80, 400);
+				for (int time = 81; time <= 400; time++) {
+					stepped.takeAction(time);
+				}
+
+				int i = 0;
+				for (const auto &result: {advanced, stepped}) {
+					groundPower[i] += result.groundPower;
+					airPower[i] += result.airPower;
+					airProduction[i] += result.airProduction;
+					combatUnits[i] += result.enemyCombatUnits;
+					for (const auto amount: result.units) {
+						units[i] += amount;
+					}
+					i++;
+				}
+			}
+
+			CHECK(groundPower[0] == doctest::Approx(groundPower[1]).epsilon(0.03));
+			CHECK(airPower[0] == doctest::Approx(airPower[1]).epsilon(0.05));
+			CHECK(airProduction[0] == doctest::Approx(airProduction[1]).epsilon(0.03));
+			CHECK(combatUnits[0] == doctest::Approx(combatUnits[1]).epsilon(0.03));
+			CHECK(units[0] == doctest::Approx(units[1]).epsilon(0.03));
+		}
 		SUBCASE("Enemies can add ground and air production") {
 			auto initialAirProduction = enemy.airProduction;
 			auto initialGroundProduction = enemy.groundProduction;